@@ -4,6 +4,7 @@
 #include <cstring> // using memset()
 
 #include "SHA1.hpp"
+#include "SHA1Digest.hpp"
 
 /**
  * 内部结构体
@@ -21,11 +22,14 @@ struct _SHA1Context {
 	uint8_t Message_Block[64]; ///< 512-bit message blocks
 	int Computed; ///< Is the digest computed?
 	int Corrupted; ///< Is the message digest corrupted?
+	int Collision_Detection; ///< Is collision detection enabled? (kept across SHA1Reset())
+	int Collision_Detected; ///< Has a collision attack block been detected?
 };
 
 SHA1::SHA1() {
 	this->context = new SHA1Context;
 	assert(this->context);
+	this->context->Collision_Detection = 0;
 	(void) SHA1Reset(this->context);
 }
 
@@ -72,11 +76,14 @@ void SHA1::getHashResult(uint8_t digest[SHA1HashSize]) {
 	memcpy(snapshot.Message_Block, this->context->Message_Block, this->context->Message_Block_Index);
 	snapshot.Computed = this->context->Computed;
 	snapshot.Corrupted = this->context->Corrupted;
+	snapshot.Collision_Detection = this->context->Collision_Detection;
+	snapshot.Collision_Detected = this->context->Collision_Detected;
 #endif
 
 	/* Note: 此处只对快照备份数据进行 padding 操作并生成摘要, 不会修改原始数据 */
 	int err;
 	err = SHA1Result(&snapshot, digest);
+	this->context->Collision_Detected = snapshot.Collision_Detected; // 最后一个块在快照上压缩, 检测结果需要带回
 	(void) SHA1Reset(&snapshot); // 通过 Reset() 和 memset() 清除 snapshot 内部残留数据
 	memset(snapshot.Message_Block, 0x00, sizeof(snapshot.Message_Block));
 	if (err) {
@@ -90,10 +97,22 @@ void SHA1::getHashResult(std::array<uint8_t, SHA1HashSize>& digest) {
 }
 #endif
 
+void SHA1::getHashResult(SHA1Digest& digest) {
+	getHashResult(digest.bytes);
+}
+
 void SHA1::reset() {
 	(void) SHA1Reset(this->context);
 }
 
+void SHA1::setCollisionDetection(bool enable) {
+	(void) SHA1SetCollisionDetection(this->context, enable ? 1 : 0);
+}
+
+bool SHA1::isCollisionDetected() {
+	return this->context->Collision_Detected != 0;
+}
+
 // ===========================================================================
 // SHA1 上下文的创建和释放(C 语言 API 接口)
 // ===========================================================================
@@ -103,6 +122,9 @@ SHA1Context *SHA1CreateNewContext()
 	SHA1Context *context;
 
 	context = (SHA1Context *) malloc(sizeof(SHA1Context));
+	if (context) {
+		context->Collision_Detection = 0;
+	}
 	SHA1Reset(context); // 默认自动执行一次复位清零
 	return context;
 }
@@ -153,6 +175,8 @@ static uint32_t ntohl(uint32_t bigEndian); // Standard "net endian to host endia
 #endif
 static void SHA1PadMessage(SHA1Context *);
 static void SHA1ProcessMessageBlock(SHA1Context *);
+static int SHA1DetectCollision(const uint32_t W[80], const uint32_t ihvout[5],
+		const uint32_t state58[5], const uint32_t state65[5], const uint32_t K[4]);
 
 /*
  * SHA1Reset
@@ -183,6 +207,32 @@ int SHA1Reset(SHA1Context *context) {
 	context->Intermediate_Hash[4] = ntohl(0xF0E1D2C3);
 	context->Computed = 0;
 	context->Corrupted = 0;
+	context->Collision_Detected = 0;
+	return shaSuccess;
+}
+
+/*
+ * SHA1SetCollisionDetection
+ *
+ * Description:
+ * This function enables or disables the detection of collision
+ * attack blocks for the given context.
+ *
+ * Parameters:
+ * context: [in/out]
+ * The context to configure.
+ * enable: [in]
+ * Non-zero to enable detection.
+ *
+ * Returns:
+ * sha Error Code.
+ *
+ */
+int SHA1SetCollisionDetection(SHA1Context *context, int enable) {
+	if (!context) {
+		return shaNull;
+	}
+	context->Collision_Detection = enable ? 1 : 0;
 	return shaSuccess;
 }
 
@@ -228,6 +278,9 @@ int SHA1Result(SHA1Context *context, uint8_t Message_Digest[SHA1HashSize]) {
 		bigEndian[i] = htonl(context->Intermediate_Hash[i]);
 	}
 	memcpy(Message_Digest, (void *)bigEndian, SHA1HashSize);
+	if (context->Collision_Detected) {
+		return shaCollisionDetected;
+	}
 	return shaSuccess;
 }
 
@@ -268,20 +321,37 @@ int SHA1Input(SHA1Context *context, ///< 上下文指针
 	if (context->Corrupted) {
 		return context->Corrupted;
 	}
-	while (length-- && !context->Corrupted) {
-		context->Message_Block[context->Message_Block_Index++] = (*message_array & 0xFF);
-		context->Length_Low += 8;
-		if (context->Length_Low == 0) {
-			context->Length_High++;
-			if (context->Length_High == 0) {
-				/* Message is too long */
-				context->Corrupted = 1;
+	while (length && !context->Corrupted) {
+		if (context->Message_Block_Index == 0 && length >= 64) {
+			/* 缓冲区为空时整块复制, 避免对大段输入逐字节处理 */
+			memcpy(context->Message_Block, message_array, 64);
+			context->Message_Block_Index = 64;
+			context->Length_Low += 512;
+			message_array += 64;
+			length -= 64;
+			if (context->Length_Low < 512) {
+				context->Length_High++;
+				if (context->Length_High == 0) {
+					/* Message is too long */
+					context->Corrupted = 1;
+				}
+			}
+		} else {
+			context->Message_Block[context->Message_Block_Index++] = (*message_array & 0xFF);
+			context->Length_Low += 8;
+			message_array++;
+			length--;
+			if (context->Length_Low == 0) {
+				context->Length_High++;
+				if (context->Length_High == 0) {
+					/* Message is too long */
+					context->Corrupted = 1;
+				}
 			}
 		}
 		if (context->Message_Block_Index == 64) {
 			SHA1ProcessMessageBlock(context);
 		}
-		message_array++;
 	}
 	return shaSuccess;
 }
@@ -383,6 +453,7 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 	uint32_t temp; /* Temporary word value (Always stroed in localhost's endian format)*/
 	uint32_t W[80]; /* Word sequence (Always stroed in localhost's endian format)*/
 	uint32_t A, B, C, D, E; /* Word buffers (Always stroed in localhost's endian format)*/
+	uint32_t state58[5], state65[5]; /* Working state before step 58 and step 65, used by collision detection */
 	/*
 	 * Initialize the first 16 words in the array W
 	 */
@@ -414,7 +485,11 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 		B = A;
 		A = temp;
 	}
-	for (t = 40; t < 60; t++) {
+	/*
+	 * 第 40~59 步和第 60~79 步分别在第 58 步和第 65 步处拆分,
+	 * 保存碰撞检测重新压缩(recompression)所需的中间状态
+	 */
+	for (t = 40; t < 58; t++) {
 		temp = SHA1CircularShift(5, A) + ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
 		E = D;
 		D = C;
@@ -422,7 +497,33 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 		B = A;
 		A = temp;
 	}
-	for (t = 60; t < 80; t++) {
+	state58[0] = A;
+	state58[1] = B;
+	state58[2] = C;
+	state58[3] = D;
+	state58[4] = E;
+	for (t = 58; t < 60; t++) {
+		temp = SHA1CircularShift(5, A) + ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
+		E = D;
+		D = C;
+		C = SHA1CircularShift(30, B);
+		B = A;
+		A = temp;
+	}
+	for (t = 60; t < 65; t++) {
+		temp = SHA1CircularShift(5, A) + (B ^ C ^ D) + E + W[t] + K[3];
+		E = D;
+		D = C;
+		C = SHA1CircularShift(30, B);
+		B = A;
+		A = temp;
+	}
+	state65[0] = A;
+	state65[1] = B;
+	state65[2] = C;
+	state65[3] = D;
+	state65[4] = E;
+	for (t = 65; t < 80; t++) {
 		temp = SHA1CircularShift(5, A) + (B ^ C ^ D) + E + W[t] + K[3];
 		E = D;
 		D = C;
@@ -435,6 +536,10 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
 	context->Intermediate_Hash[2] += C;
 	context->Intermediate_Hash[3] += D;
 	context->Intermediate_Hash[4] += E;
+	if (context->Collision_Detection
+			&& SHA1DetectCollision(W, context->Intermediate_Hash, state58, state65, K)) {
+		context->Collision_Detected = 1;
+	}
 	context->Message_Block_Index = 0;
 }
 
@@ -443,6 +548,601 @@ void SHA1ProcessMessageBlock(SHA1Context *context) {
  * @see https://tools.ietf.org/html/rfc3174
  */
 
+// ===========================================================================
+// 碰撞检测
+// ===========================================================================
+
+/*
+ * 实现思路与 Marc Stevens 的 counter-cryptanalysis(sha1dc) 相同:
+ * 已知的 SHA-1 碰撞攻击都沿用少数几个扰动向量(disturbance vector, DV)构造差分路径.
+ * 对每个 DV, 假设当前分组是碰撞对中的一个, 用 DV 对应的消息差分 dm 构造另一个分组
+ * W' = W ^ dm, 从第 58 步(或第 65 步)的中间状态向前向后重新压缩(recompression);
+ * 若两个分组的压缩输出相同, 说明当前分组属于碰撞攻击.
+ *
+ * 重新压缩代价接近一次完整的压缩, 因此先检查差分路径在第 40 步之后必然满足的消息比特条件
+ * (unavoidable bit conditions, UBC): 局部碰撞在第 t+1 步和第 t+5 步的修正项
+ * 必须与第 t 步的扰动符号相反, 即 W[t] 的第 j 位与 W[t+1] 的第 j+5 位
+ * (或 W[t+5] 的第 j+30 位) 取值不同. 随机数据平均每个分组约有 0.13 个 DV 通过筛选,
+ * 主要来自条件最少的 I(52,0) 和 II(56,0)(各 5 个, 第 40 步之后其余扰动在第 31 位或第 74 步之后).
+ */
+
+#define SHA1_DV_COUNT 32 ///< 扰动向量个数
+#define SHA1_DV_MAX_CONDITIONS 32 ///< 每个扰动向量最多的比特条件个数
+#define SHA1_DV_FILTER_CONDITIONS 8 ///< 每个扰动向量在第一轮筛选中检查的比特条件个数
+
+/**
+ * 内部结构体: 一个比特条件, 要求 W[step] 的第 bit 位与 W[step2] 的第 bit2 位不同
+ *
+ * @note step2 = step + 1 时 bit2 = bit + 5; step2 = step + 5 时 bit2 = bit + 30 (模 32)
+ */
+typedef struct {
+	uint8_t step;
+	uint8_t bit;
+	uint8_t step2;
+	uint8_t bit2;
+	uint32_t dvMask; ///< 第一轮筛选中需要该条件的扰动向量(第 i 位对应 dv[i])
+} SHA1BitCondition;
+
+/**
+ * 内部结构体: 一个扰动向量的检测参数
+ */
+typedef struct {
+	int testt; ///< 重新压缩的起点: 58 或 65
+	int conditionCount; ///< 第二轮筛选的比特条件个数
+	SHA1BitCondition condition[SHA1_DV_MAX_CONDITIONS]; ///< 第二轮筛选的比特条件
+	uint32_t dm[80]; ///< 消息差分(异或)
+} SHA1DisturbanceVector;
+
+/**
+ * 内部类: 扰动向量表
+ *
+ * @note 按 Manuel 的分类方法由定义直接生成, 不必内嵌大段常量表:
+ * I(K,b) 型为 DV[K..K+14]=0, DV[K+15]=1<<b;
+ * II(K,b) 型在此基础上还有 DV[K+1]=DV[K+3]=rol31(1<<b).
+ * 其余各步按消息扩展递推式向前后延伸.
+ *
+ * 数据随机时每个条件成立的概率为 1/2, 逐个判断会产生大量无法预测的分支.
+ * 因此分两轮筛选: 第一轮由 SHA1CheckUnavoidableConditions() 对全部扰动向量
+ * 以 32 位掩码并行检查各自被共用最多的 SHA1_DV_FILTER_CONDITIONS 个条件;
+ * 平均只有约 0.2 个扰动向量进入第二轮, 再逐个检查其余条件.
+ */
+class SHA1DisturbanceVectorTable {
+public:
+	SHA1DisturbanceVector dv[SHA1_DV_COUNT];
+	SHA1BitCondition filter[SHA1_DV_COUNT * SHA1_DV_FILTER_CONDITIONS]; ///< 第一轮筛选的比特条件(已去重)
+	int filterCount;
+
+	SHA1DisturbanceVectorTable() :
+			filterCount(0) {
+		static const struct {
+			uint8_t type, K, b;
+		} list[SHA1_DV_COUNT] = {
+				{ 1, 43, 0 }, { 1, 44, 0 }, { 1, 45, 0 }, { 1, 46, 0 }, { 1, 46, 2 }, { 1, 47, 0 }, { 1, 47, 2 },
+				{ 1, 48, 0 }, { 1, 48, 2 }, { 1, 49, 0 }, { 1, 49, 2 }, { 1, 50, 0 }, { 1, 50, 2 }, { 1, 51, 0 },
+				{ 1, 51, 2 }, { 1, 52, 0 },
+				{ 2, 45, 0 }, { 2, 46, 0 }, { 2, 46, 2 }, { 2, 47, 0 }, { 2, 48, 0 }, { 2, 49, 0 }, { 2, 49, 2 },
+				{ 2, 50, 0 }, { 2, 50, 2 }, { 2, 51, 0 }, { 2, 51, 2 }, { 2, 52, 0 }, { 2, 53, 0 }, { 2, 54, 0 },
+				{ 2, 55, 0 }, { 2, 56, 0 },
+				};
+		int i, k, n;
+
+		for (i = 0; i < SHA1_DV_COUNT; i++) {
+			build(&dv[i], list[i].type, list[i].K, list[i].b);
+		}
+		/* 统计每个条件被多少个扰动向量共用(暂存于 dvMask), 共用多的排在前面 */
+		for (i = 0; i < SHA1_DV_COUNT; i++) {
+			for (k = 0; k < dv[i].conditionCount; k++) {
+				dv[i].condition[k].dvMask = sharedBy(dv[i].condition[k]);
+			}
+			sortConditions(&dv[i]);
+		}
+		/* 每个扰动向量的前几个条件移入第一轮 */
+		for (i = 0; i < SHA1_DV_COUNT; i++) {
+			n = (dv[i].conditionCount < SHA1_DV_FILTER_CONDITIONS) ? dv[i].conditionCount : SHA1_DV_FILTER_CONDITIONS;
+			for (k = 0; k < n; k++) {
+				addFilter(i, dv[i].condition[k]);
+			}
+			dv[i].conditionCount -= n;
+			memmove(dv[i].condition, dv[i].condition + n, dv[i].conditionCount * sizeof(SHA1BitCondition));
+		}
+	}
+
+private:
+	static uint32_t rol(uint32_t x, int n) {
+		n &= 31;
+		return n ? ((x << n) | (x >> (32 - n))) : x;
+	}
+
+	static int sameCondition(const SHA1BitCondition& a, const SHA1BitCondition& b) {
+		return a.step == b.step && a.bit == b.bit && a.step2 == b.step2;
+	}
+
+	uint32_t sharedBy(const SHA1BitCondition& c) const {
+		uint32_t n = 0;
+		int i, k;
+
+		for (i = 0; i < SHA1_DV_COUNT; i++) {
+			for (k = 0; k < dv[i].conditionCount; k++) {
+				n += sameCondition(dv[i].condition[k], c);
+			}
+		}
+		return n;
+	}
+
+	static void sortConditions(SHA1DisturbanceVector *v) {
+		int i, k;
+
+		for (i = 1; i < v->conditionCount; i++) {
+			SHA1BitCondition c = v->condition[i];
+
+			for (k = i; k > 0 && v->condition[k - 1].dvMask < c.dvMask; k--) {
+				v->condition[k] = v->condition[k - 1];
+			}
+			v->condition[k] = c;
+		}
+	}
+
+	/* 第 i 个扰动向量的条件加入第一轮, 相同的条件只保存一次 */
+	void addFilter(int i, const SHA1BitCondition& c) {
+		int k;
+
+		for (k = 0; k < filterCount; k++) {
+			if (sameCondition(filter[k], c)) {
+				filter[k].dvMask |= (uint32_t) 1 << i;
+				return;
+			}
+		}
+		filter[k] = c;
+		filter[k].dvMask = (uint32_t) 1 << i;
+		filterCount++;
+	}
+
+	static void addCondition(SHA1DisturbanceVector *v, int t, int bit, int t2, int bit2) {
+		SHA1BitCondition *c;
+
+		assert(v->conditionCount < SHA1_DV_MAX_CONDITIONS);
+		c = &v->condition[v->conditionCount++];
+		c->step = (uint8_t) t;
+		c->bit = (uint8_t) bit;
+		c->step2 = (uint8_t) t2;
+		c->bit2 = (uint8_t) bit2;
+		c->dvMask = 0;
+	}
+
+	static void build(SHA1DisturbanceVector *v, int type, int K, int b) {
+		uint32_t w[85]; /* DV[-5..79], 下标偏移 5 */
+		uint8_t count[85][32]; /* 每个比特位置上的扰动及修正项个数 */
+		int t, j, k;
+
+		memset(w, 0, sizeof(w));
+		memset(count, 0, sizeof(count));
+		w[K + 15 + 5] = (uint32_t) 1 << b;
+		if (type == 2) {
+			w[K + 1 + 5] = w[K + 3 + 5] = rol((uint32_t) 1 << b, 31);
+		}
+		for (t = K + 16; t < 80; t++) {
+			w[t + 5] = rol(w[t - 3 + 5] ^ w[t - 8 + 5] ^ w[t - 14 + 5] ^ w[t - 16 + 5], 1);
+		}
+		for (t = K + 15; t - 16 >= -5; t--) {
+			w[t - 16 + 5] = rol(w[t + 5], 31) ^ w[t - 3 + 5] ^ w[t - 8 + 5] ^ w[t - 14 + 5];
+		}
+
+		v->testt = 65;
+		for (t = 53; t < 58 && !w[t + 5]; t++) {
+		}
+		if (t == 58) {
+			v->testt = 58;
+		}
+		for (t = 0; t < 80; t++) {
+			v->dm[t] = w[t + 5] ^ rol(w[t - 1 + 5], 5) ^ w[t - 2 + 5] ^ rol(w[t - 3 + 5], 30) ^ rol(w[t - 4 + 5], 30)
+					^ rol(w[t - 5 + 5], 30);
+		}
+
+		/* 第 t 步第 j 位的扰动在第 t..t+5 步产生的异或差分位置 */
+		static const int dt[6] = { 0, 1, 2, 3, 4, 5 };
+		static const int dj[6] = { 0, 5, 0, 30, 30, 30 };
+		for (t = -5; t < 80; t++) {
+			for (j = 0; j < 32; j++) {
+				if (!((w[t + 5] >> j) & 1)) {
+					continue;
+				}
+				for (k = 0; k < 6; k++) {
+					if (t + dt[k] < 80) {
+						count[t + dt[k] + 5][(j + dj[k]) & 31]++;
+					}
+				}
+			}
+		}
+		/*
+		 * 只使用不受其他扰动和进位影响的条件: 第 31 位(无符号)和重叠位置都跳过.
+		 * 第 75 步及之后开始的局部碰撞在第 80 步之前不会完成, 其差分留在压缩输出中
+		 * (近似碰撞的输出差分), 修正项的符号可以由攻击者任意选择, 不是必然条件.
+		 */
+		v->conditionCount = 0;
+		for (t = 40; t + 5 < 80; t++) {
+			for (j = 0; j < 31; j++) {
+				if (!((w[t + 5] >> j) & 1) || count[t + 5][j] != 1) {
+					continue;
+				}
+				if (((j + 5) & 31) != 31 && count[t + 1 + 5][(j + 5) & 31] == 1) {
+					addCondition(v, t, j, t + 1, (j + 5) & 31);
+				}
+				if (((j + 30) & 31) != 31 && count[t + 5 + 5][(j + 30) & 31] == 1) {
+					addCondition(v, t, j, t + 5, (j + 30) & 31);
+				}
+			}
+		}
+	}
+};
+
+/* 返回比特条件是否成立(1 或 0) */
+static inline uint32_t SHA1CheckCondition(const uint32_t W[80], const SHA1BitCondition *c) {
+	return ((W[c->step] >> c->bit) ^ (W[c->step2] >> c->bit2)) & 1;
+}
+
+/*
+ * SHA1CheckUnavoidableConditions
+ *
+ * Description:
+ * 第一轮筛选: 返回满足第一轮全部比特条件的扰动向量掩码(第 i 位对应 dv[i]).
+ * 与 sha1dc 的 ubc_check() 相同, 按 (W[t], W[t+1]) 或 (W[t], W[t+5]) 分组,
+ * 每组只计算一次 x = W[t] ^ rol(W[t+1], 27) (或 rol(W[t+5], 2)), x 的第 j 位即为条件是否成立;
+ * 条件不成立时清除需要该条件的扰动向量, 整个函数没有分支和循环.
+ *
+ * @note 以下代码由 SHA1DisturbanceVectorTable::filter[] 生成, 修改扰动向量表或
+ * SHA1_DV_FILTER_CONDITIONS 之后需要重新生成; 调试版本在首次使用时与 filter[] 逐一比对.
+ */
+static uint32_t SHA1CheckUnavoidableConditions(const uint32_t W[80]) {
+	uint32_t mask = ~(uint32_t) 0;
+	uint32_t x;
+
+	x = W[40] ^ SHA1CircularShift(27, W[41]);
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00000040U; // I(47,2)
+	mask &= (0 - ((x >> 30) & 1)) | ~0x10000000U; // II(53,0)
+
+	x = W[40] ^ SHA1CircularShift(2, W[45]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x10000000U; // II(53,0)
+
+	x = W[41] ^ SHA1CircularShift(27, W[42]);
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00000100U; // I(48,2)
+	mask &= (0 - ((x >> 30) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[41] ^ SHA1CircularShift(2, W[46]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[42] ^ SHA1CircularShift(27, W[43]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x40000000U; // II(55,0)
+
+	x = W[42] ^ SHA1CircularShift(2, W[47]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x40000000U; // II(55,0)
+
+	x = W[43] ^ SHA1CircularShift(27, W[44]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x80000000U; // II(56,0)
+
+	x = W[43] ^ SHA1CircularShift(2, W[48]);
+	mask &= (0 - ((x >> 30) & 1)) | ~0x80000000U; // II(56,0)
+
+	x = W[61] ^ SHA1CircularShift(27, W[62]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000010U; // I(46,2)
+
+	x = W[61] ^ SHA1CircularShift(2, W[66]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000010U; // I(46,2)
+
+	x = W[62] ^ SHA1CircularShift(27, W[63]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000020U; // I(47,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000040U; // I(47,2)
+
+	x = W[62] ^ SHA1CircularShift(2, W[67]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000020U; // I(47,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000040U; // I(47,2)
+
+	x = W[63] ^ SHA1CircularShift(27, W[64]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000080U; // I(48,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000100U; // I(48,2)
+
+	x = W[63] ^ SHA1CircularShift(2, W[68]);
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00000080U; // I(48,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000100U; // I(48,2)
+
+	x = W[64] ^ SHA1CircularShift(27, W[65]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00400401U; // I(43,0) I(49,2) II(49,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000010U; // I(46,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00200200U; // I(49,0) II(49,0)
+
+	x = W[64] ^ SHA1CircularShift(2, W[69]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00400401U; // I(43,0) I(49,2) II(49,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000010U; // I(46,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00200200U; // I(49,0) II(49,0)
+
+	x = W[65] ^ SHA1CircularShift(27, W[66]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000040U; // I(47,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00820800U; // I(50,0) II(46,0) II(50,0)
+
+	x = W[65] ^ SHA1CircularShift(2, W[70]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000040U; // I(47,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x00820800U; // I(50,0) II(46,0) II(50,0)
+
+	x = W[66] ^ SHA1CircularShift(27, W[67]);
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00100081U; // I(43,0) I(48,0) II(48,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x04014004U; // I(45,0) I(51,2) II(45,0) II(51,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000100U; // I(48,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x02082000U; // I(51,0) II(47,0) II(51,0)
+
+	x = W[66] ^ SHA1CircularShift(2, W[71]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x04014004U; // I(45,0) I(51,2) II(45,0) II(51,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000100U; // I(48,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x02082000U; // I(51,0) II(47,0) II(51,0)
+
+	x = W[67] ^ SHA1CircularShift(27, W[68]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00400401U; // I(43,0) I(49,2) II(49,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00210202U; // I(44,0) I(49,0) II(45,0) II(49,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000010U; // I(46,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x08108000U; // I(52,0) II(48,0) II(52,0)
+
+	x = W[67] ^ SHA1CircularShift(2, W[72]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000010U; // I(46,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x08108000U; // I(52,0) II(48,0) II(52,0)
+
+	x = W[68] ^ SHA1CircularShift(27, W[69]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x00830804U; // I(45,0) I(50,0) II(45,0) II(46,0) II(50,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00480020U; // I(47,0) II(47,0) II(49,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000040U; // I(47,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x10000000U; // II(53,0)
+
+	x = W[68] ^ SHA1CircularShift(2, W[73]);
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00480020U; // I(47,0) II(47,0) II(49,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000040U; // I(47,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x10000000U; // II(53,0)
+
+	x = W[69] ^ SHA1CircularShift(27, W[70]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x04054014U; // I(45,0) I(46,2) I(51,2) II(45,0) II(46,2) II(51,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x020a2008U; // I(46,0) I(51,0) II(46,0) II(47,0) II(51,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00100080U; // I(48,0) II(48,0)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000100U; // I(48,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[69] ^ SHA1CircularShift(2, W[74]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x04044010U; // I(46,2) I(51,2) II(46,2) II(51,2)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00100080U; // I(48,0) II(48,0)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000100U; // I(48,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[70] ^ SHA1CircularShift(27, W[71]);
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00400401U; // I(43,0) I(49,2) II(49,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00020048U; // I(46,0) I(47,2) II(46,0)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x08188020U; // I(47,0) I(52,0) II(47,0) II(48,0) II(52,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x04210200U; // I(49,0) II(45,0) II(49,0) II(51,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x42000000U; // II(51,0) II(55,0)
+
+	x = W[70] ^ SHA1CircularShift(2, W[75]);
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000401U; // I(43,0) I(49,2)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x04200200U; // I(49,0) II(49,0) II(51,2)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x40000000U; // II(55,0)
+
+	x = W[71] ^ SHA1CircularShift(27, W[72]);
+	mask &= (0 - ((x >> 4) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00480120U; // I(47,0) I(48,2) II(47,0) II(49,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x10300080U; // I(48,0) II(48,0) II(49,0) II(53,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00820800U; // I(50,0) II(46,0) II(50,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x88000000U; // II(52,0) II(56,0)
+
+	x = W[71] ^ SHA1CircularShift(2, W[76]);
+	mask &= (0 - ((x >> 4) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x00820800U; // I(50,0) II(46,0) II(50,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x88000000U; // II(52,0) II(56,0)
+
+	x = W[72] ^ SHA1CircularShift(27, W[73]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x01500481U; // I(43,0) I(48,0) I(49,2) II(48,0) II(49,2) II(50,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00004004U; // I(45,0) I(51,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x20a00200U; // I(49,0) II(49,0) II(50,0) II(54,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x02082000U; // I(51,0) II(47,0) II(51,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x10000000U; // II(53,0)
+
+	x = W[72] ^ SHA1CircularShift(2, W[77]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00000401U; // I(43,0) I(49,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00004004U; // I(45,0) I(51,2)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x02002000U; // I(51,0) II(51,0)
+
+	x = W[73] ^ SHA1CircularShift(27, W[74]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x05211202U; // I(44,0) I(49,0) I(50,2) II(45,0) II(49,0) II(50,2) II(51,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000008U; // I(46,0)
+	mask &= (0 - ((x >> 5) & 1)) | ~0x00000400U; // I(49,2)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x42800800U; // I(50,0) II(50,0) II(51,0) II(55,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x08008000U; // I(52,0) II(52,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[73] ^ SHA1CircularShift(2, W[78]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00001000U; // I(50,2)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x08008000U; // I(52,0) II(52,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x20000000U; // II(54,0)
+
+	x = W[74] ^ SHA1CircularShift(27, W[75]);
+	mask &= (0 - ((x >> 5) & 1)) | ~0x01041002U; // I(44,0) I(50,2) II(46,2) II(50,2)
+	mask &= (0 - ((x >> 3) & 1)) | ~0x04834804U; // I(45,0) I(50,0) I(51,2) II(45,0) II(46,0) II(50,0) II(51,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000020U; // I(47,0)
+	mask &= (0 - ((x >> 1) & 1)) | ~0x8a002000U; // I(51,0) II(51,0) II(52,0) II(56,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x10000000U; // II(53,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x40000000U; // II(55,0)
+
+	x = W[74] ^ SHA1CircularShift(2, W[79]);
+	mask &= (0 - ((x >> 3) & 1)) | ~0x00004004U; // I(45,0) I(51,2)
+	mask &= (0 - ((x >> 4) & 1)) | ~0x00000020U; // I(47,0)
+	mask &= (0 - ((x >> 2) & 1)) | ~0x10000000U; // II(53,0)
+	mask &= (0 - ((x >> 0) & 1)) | ~0x40000000U; // II(55,0)
+
+	return mask;
+}
+
+#ifndef NDEBUG
+/* 用固定的伪随机消息比较 SHA1CheckUnavoidableConditions() 与 filter[] 的筛选结果 */
+static bool SHA1VerifyUnavoidableConditions(const SHA1DisturbanceVectorTable& table) {
+	uint32_t W[80];
+	uint32_t seed = 0x67452301;
+	uint32_t expected;
+	int n, t, k;
+
+	for (n = 0; n < 4096; n++) {
+		for (t = 0; t < 80; t++) {
+			seed = seed * 1664525 + 1013904223;
+			W[t] = seed;
+		}
+		expected = ~(uint32_t) 0;
+		for (k = 0; k < table.filterCount; k++) {
+			expected &= ~(table.filter[k].dvMask & (SHA1CheckCondition(W, &table.filter[k]) - 1));
+		}
+		if (SHA1CheckUnavoidableConditions(W) != expected) {
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
+static const SHA1DisturbanceVectorTable& SHA1DisturbanceVectors() {
+	static const SHA1DisturbanceVectorTable table;
+#ifndef NDEBUG
+	static const bool verified = SHA1VerifyUnavoidableConditions(table);
+
+	assert(verified);
+#endif
+	return table;
+}
+
+/*
+ * SHA1Recompress
+ *
+ * Description:
+ * 从第 testt 步之前的中间状态出发, 对消息 me2 反向计算到输入链接值 ihvin',
+ * 再正向计算到第 80 步, 判断 ihvin' + S80' 是否等于 ihvout.
+ * 与 SHA1ProcessMessageBlock() 相同, 按轮函数分段循环, 循环内没有分支.
+ */
+#define SHA1_BACKWARD_STEP(f, k) \
+	temp = B; \
+	B = SHA1CircularShift(2, C); \
+	C = D; \
+	D = E; \
+	E = A - SHA1CircularShift(5, temp) - (f) - (k) - me2[t]; \
+	A = temp
+#define SHA1_FORWARD_STEP(f, k) \
+	temp = SHA1CircularShift(5, A) + (f) + E + me2[t] + (k); \
+	E = D; \
+	D = C; \
+	C = SHA1CircularShift(30, B); \
+	B = A; \
+	A = temp
+#define SHA1_CH(B, C, D) (((B) & (C)) | ((~(B)) & (D)))
+#define SHA1_PARITY(B, C, D) ((B) ^ (C) ^ (D))
+#define SHA1_MAJ(B, C, D) (((B) & (C)) | ((B) & (D)) | ((C) & (D)))
+
+static int SHA1Recompress(const uint32_t me2[80], int testt, const uint32_t state[5], const uint32_t K[4],
+		const uint32_t ihvout[5]) {
+	uint32_t A, B, C, D, E, temp, ihvin[5];
+	int t;
+
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+	for (t = testt - 1; t >= 60; t--) {
+		SHA1_BACKWARD_STEP(SHA1_PARITY(B, C, D), K[3]);
+	}
+	for (; t >= 40; t--) {
+		SHA1_BACKWARD_STEP(SHA1_MAJ(B, C, D), K[2]);
+	}
+	for (; t >= 20; t--) {
+		SHA1_BACKWARD_STEP(SHA1_PARITY(B, C, D), K[1]);
+	}
+	for (; t >= 0; t--) {
+		SHA1_BACKWARD_STEP(SHA1_CH(B, C, D), K[0]);
+	}
+	ihvin[0] = A;
+	ihvin[1] = B;
+	ihvin[2] = C;
+	ihvin[3] = D;
+	ihvin[4] = E;
+
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+	for (t = testt; t < 60; t++) {
+		SHA1_FORWARD_STEP(SHA1_MAJ(B, C, D), K[2]);
+	}
+	for (; t < 80; t++) {
+		SHA1_FORWARD_STEP(SHA1_PARITY(B, C, D), K[3]);
+	}
+	return ihvin[0] + A == ihvout[0] && ihvin[1] + B == ihvout[1] && ihvin[2] + C == ihvout[2]
+			&& ihvin[3] + D == ihvout[3] && ihvin[4] + E == ihvout[4];
+}
+
+#undef SHA1_BACKWARD_STEP
+#undef SHA1_FORWARD_STEP
+#undef SHA1_CH
+#undef SHA1_PARITY
+#undef SHA1_MAJ
+
+/*
+ * SHA1DetectCollision
+ *
+ * Description:
+ * This function checks whether the message block just compressed
+ * is one block of a collision pair built from a known disturbance
+ * vector.
+ *
+ * Parameters:
+ * W: [in]
+ * The expanded message words.
+ * ihvout: [in]
+ * The chaining value after the compression.
+ * state58, state65: [in]
+ * The working state before step 58 and step 65.
+ * K: [in]
+ * The round constants.
+ *
+ * Returns:
+ * Non-zero if a collision block is detected.
+ *
+ */
+int SHA1DetectCollision(const uint32_t W[80], const uint32_t ihvout[5],
+		const uint32_t state58[5], const uint32_t state65[5], const uint32_t K[4]) {
+	const SHA1DisturbanceVectorTable& table = SHA1DisturbanceVectors();
+	uint32_t me2[80];
+	uint32_t candidates; /* 满足第一轮比特条件的扰动向量 */
+	int i, k, t;
+
+	candidates = SHA1CheckUnavoidableConditions(W);
+	for (i = 0; candidates; i++, candidates >>= 1) {
+		const SHA1DisturbanceVector *v = &table.dv[i];
+
+		if (!(candidates & 1)) {
+			continue;
+		}
+		for (k = 0; k < v->conditionCount && SHA1CheckCondition(W, &v->condition[k]); k++) {
+		}
+		if (k < v->conditionCount) {
+			continue;
+		}
+		for (t = 0; t < 80; t++) {
+			me2[t] = W[t] ^ v->dm[t];
+		}
+		/* 碰撞对中另一个分组的输入链接值可能不同(近似碰撞), 由重新压缩求出 */
+		if (SHA1Recompress(me2, v->testt, (v->testt == 58) ? state58 : state65, K, ihvout)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
 // ===========================================================================
 // 网络字节序-本机字节序转换
 // ===========================================================================
@@ -54,6 +54,9 @@ enum
 	shaNull, ///< Null pointer parameter
 	shaInputTooLong, ///< input data too long
 	shaStateError, ///< This error happens when another SHA1Input() is called unexpectedly after SHA1Result()
+	shaBadParam, ///< Passed a bad parameter
+	shaFileError, ///< File I/O error (open/read/write/mmap failed or file format is invalid)
+	shaCollisionDetected, ///< A SHA-1 collision attack block was detected in the input (the digest is still computed)
 };
 #endif
 #define SHA1HashSize 20 ///< SHA1 哈希摘要结果长度(20 字节)
@@ -93,13 +96,27 @@ int SHA1Input(
 /**
  * 从 SHA1 上下文取出哈希摘要结果
  *
- * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaStateError
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaStateError / shaCollisionDetected(摘要仍会输出)
  */
 int SHA1Result(
 		SHA1Context *context, ///< 上下文指针
 		uint8_t Message_Digest[SHA1HashSize] ///< 输出 SHA1HashSize=20 字节哈希摘要
 		);
 
+/**
+ * 开启或关闭碰撞检测模式
+ *
+ * @details 开启后每个消息分组都会检查是否为已知差分路径(扰动向量)构造的碰撞分组,
+ * 例如 SHAttered 攻击中的分组; 检测到时 SHA1Result() 返回 shaCollisionDetected.
+ * 该设置在 SHA1Reset() 之后保持不变.
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull
+ */
+int SHA1SetCollisionDetection(
+		SHA1Context *context, ///< 上下文指针
+		int enable ///< 非 0 表示开启, 0 表示关闭(默认)
+		);
+
 /**
  * 创建 SHA1 上下文对象
  *
@@ -22,6 +22,8 @@
 #include <array> /// @note 使用 std::array<uint8_t, 20> 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
 #endif // __cplusplus >= 201103L
 
+struct SHA1Digest; // 定义于 SHA1Digest.hpp
+
 /**
  * @class SHA1
  * @brief 面向对象的 SHA1 哈希摘要计算器 API
@@ -67,9 +69,22 @@ public:
 	void getHashResult(std::array<uint8_t, SHA1HashSize>& digest///< 输出 SHA1 摘要
 			);
 	#endif
+	void getHashResult(SHA1Digest& digest ///< 输出 SHA1 摘要
+			);
 
 	/** 清除当前运算结果和所有中间数据 */
 	void reset();
+
+	/** 开启或关闭碰撞检测模式(默认关闭), reset() 后保持不变 */
+	void setCollisionDetection(bool enable ///< true 表示开启
+			);
+
+	/**
+	 * 查询是否检测到碰撞攻击
+	 *
+	 * @return true 表示自上次 reset() 以来输入的数据中包含碰撞攻击分组
+	 */
+	bool isCollisionDetected();
 };
 
 #endif//_SHA1_HPP_
@@ -0,0 +1,220 @@
+#include "SHA1Async.hpp"
+#include "SHA1FileInput.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** 不可定位的非阻塞描述符暂无数据时, 让出工作线程前最多等待的时间(毫秒) */
+static const int kStreamWaitMs = 10;
+
+// ===========================================================================
+// SHA1HashAwaitable
+// ===========================================================================
+
+SHA1HashAwaitable::SHA1HashAwaitable(SHA1HashExecutor *executor, Resumer resumer) :
+		executor(executor), resumer(std::move(resumer)), data(NULL), fd(-1), stream(false), offset(0), remaining(0) {
+	result.status = shaSuccess;
+	result.length = 0;
+	memset(result.digest.bytes, 0, SHA1HashSize);
+}
+
+/*
+ * 参数错误的请求不提交, 返回 false 使协程立即恢复
+ */
+bool SHA1HashAwaitable::await_suspend(std::coroutine_handle<> handle) {
+	if (result.status != shaSuccess) {
+		return false;
+	}
+	continuation = handle;
+	executor->submit(this);
+	return true;
+}
+
+// ===========================================================================
+// SHA1HashExecutor
+// ===========================================================================
+
+SHA1HashExecutor::SHA1HashExecutor(unsigned int threads, size_t smallLimit, size_t sliceSize) :
+		smallLimit(smallLimit), sliceSize(std::max<size_t>(sliceSize, 64)), stopping(false) {
+	if (threads == 0) {
+		threads = std::max(1U, std::thread::hardware_concurrency());
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&SHA1HashExecutor::workerLoop, this);
+	}
+}
+
+SHA1HashExecutor::~SHA1HashExecutor() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+SHA1HashAwaitable SHA1HashExecutor::hash(const uint8_t data[], size_t length, SHA1HashAwaitable::Resumer resumer) {
+	SHA1HashAwaitable request(this, std::move(resumer));
+
+	if (!data && length) {
+		request.result.status = shaNull;
+	}
+	request.data = data;
+	request.remaining = length;
+	return request;
+}
+
+SHA1HashAwaitable SHA1HashExecutor::hashFile(int fd, uint64_t offset, uint64_t length,
+		SHA1HashAwaitable::Resumer resumer) {
+	SHA1HashAwaitable request(this, std::move(resumer));
+	struct stat st;
+
+	request.fd = fd;
+	request.offset = offset;
+	request.remaining = length;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		request.result.status = shaFileError;
+	} else if (S_ISREG(st.st_mode)) {
+		/* 普通文件按实际长度截断, 以便把小文件归入小请求 */
+		uint64_t size = (uint64_t) st.st_size;
+
+		request.remaining = (offset < size) ? std::min(length, size - offset) : 0;
+	} else if (lseek(fd, 0, SEEK_CUR) < 0 && errno == ESPIPE) {
+		/* 管道/套接字: 只能从当前位置顺序读取 */
+		request.stream = true;
+		if (offset != 0) {
+			request.result.status = shaBadParam;
+		}
+	}
+	return request;
+}
+
+void SHA1HashExecutor::submit(SHA1HashAwaitable *request) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (request->remaining <= smallLimit && !request->stream) { // 流的长度未知且可能需要等待, 总按大请求切片处理
+			smallQueue.push_back(request);
+		} else {
+			largeQueue.push_back(request);
+		}
+	}
+	wakeup.notify_one();
+}
+
+/*
+ * 对请求计算最多 budget 字节, 返回 true 表示请求已完成(成功或出错)
+ */
+bool SHA1HashExecutor::runSlice(SHA1HashAwaitable *request, size_t budget) {
+	SHA1& hasher = *request->hasher;
+
+	if (request->data) {
+		uint64_t n = std::min<uint64_t>(request->remaining, budget);
+
+		SHA1InputBuffer(hasher, request->data + request->offset, n);
+		request->offset += n;
+		request->remaining -= n;
+		request->result.length += n;
+	} else if (request->fd >= 0) {
+		uint64_t want = std::min<uint64_t>(request->remaining, budget);
+		uint64_t n;
+		int err;
+
+		err = SHA1InputFd(hasher, request->fd, request->offset, want, request->stream, &n);
+		request->offset += n;
+		request->remaining -= n;
+		request->result.length += n;
+		if (err && request->stream && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			/* 非阻塞流暂无数据: 短暂等待后让出工作线程, 本时间片结束 */
+			struct pollfd pfd;
+
+			pfd.fd = request->fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			(void) poll(&pfd, 1, kStreamWaitMs);
+			return false;
+		}
+		if (err) {
+			request->result.status = shaFileError;
+			return true;
+		}
+		if (n < want) {
+			request->remaining = 0; // 文件末尾
+		}
+	}
+	if (request->remaining > 0) {
+		return false;
+	}
+	hasher.inputEnd();
+	hasher.getHashResult(request->result.digest);
+	return true;
+}
+
+/*
+ * 恢复等待该请求的协程
+ *
+ * 协程恢复后可等待对象随协程帧一起失效, 因此先把恢复方式移出, 之后不再访问 request.
+ */
+void SHA1HashExecutor::complete(SHA1HashAwaitable *request) {
+	SHA1HashAwaitable::Resumer resumer = std::move(request->resumer);
+	std::coroutine_handle<> handle = request->continuation;
+
+	request->hasher.reset();
+	if (resumer) {
+		resumer(handle);
+	} else {
+		handle.resume();
+	}
+}
+
+void SHA1HashExecutor::workerLoop() {
+	std::vector<SHA1HashAwaitable *> batch;
+
+	batch.reserve(MaxBatch);
+	for (;;) {
+		SHA1HashAwaitable *large = NULL;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this] { return stopping || !smallQueue.empty() || !largeQueue.empty(); });
+			if (!smallQueue.empty()) {
+				/* 小请求优先: 一次取出一批 */
+				while (!smallQueue.empty() && batch.size() < MaxBatch) {
+					batch.push_back(smallQueue.front());
+					smallQueue.pop_front();
+				}
+			} else if (!largeQueue.empty()) {
+				large = largeQueue.front();
+				largeQueue.pop_front();
+			} else {
+				return; // stopping 且队列已清空
+			}
+		}
+
+		for (size_t i = 0; i < batch.size(); i++) {
+			batch[i]->hasher.reset(new SHA1);
+			(void) runSlice(batch[i], ~(size_t) 0);
+			complete(batch[i]);
+		}
+		batch.clear();
+
+		if (large) {
+			if (!large->hasher) {
+				large->hasher.reset(new SHA1);
+			}
+			if (runSlice(large, sliceSize)) {
+				complete(large);
+			} else {
+				/* 未完成的大请求回到队尾, 与其他大请求轮转, 并让位于期间到达的小请求 */
+				std::lock_guard<std::mutex> lock(mutex);
+				largeQueue.push_back(large);
+			}
+		}
+	}
+}
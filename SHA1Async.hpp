@@ -0,0 +1,155 @@
+/**
+* @file SHA1Async.hpp
+* @brief SHA1 异步哈希(C++20 协程) C++ 语言头文件
+*
+* @details
+* SHA1HashExecutor 拥有独立的哈希工作线程, 协程通过 co_await 提交哈希请求而不会阻塞事件循环:
+* @code
+* SHA1AsyncResult r = co_await executor.hash(data, length, resumeOnLoop);
+* @endcode
+*
+* 调度策略:
+* - 小请求(不超过 smallLimit 字节)进入优先队列, 工作线程一次取出一批连续处理, 分摊加锁和唤醒开销;
+* - 大请求按 sliceSize 字节切成时间片, 每计算完一片就回到队尾, 并优先处理期间到达的小请求,
+*   因此小请求最多只需等待一个时间片, 不会排在数 GB 的文件后面; 多个大请求之间轮转执行.
+*
+* 完成后协程在调用者指定的执行器上恢复(通过 Resumer 回调投递协程句柄), 未指定时在哈希工作线程上直接恢复.
+*
+* @note 在 co_await 返回之前, 调用者必须保证数据缓冲区/文件描述符有效
+* @note 需要 C++ 编译器支持 -std=c++20 选项并且 __cplusplus >= 202002L
+* @example example_async.cpp 是一个使用协程异步计算 SHA1 的 C++ 示例程序
+*/
+
+#ifndef _SHA1_ASYNC_HPP_
+#define _SHA1_ASYNC_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 202002L
+#error "This header requires C++20 or later"
+#endif
+
+#include "SHA1.hpp"
+#include "SHA1Digest.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SHA1HashExecutor;
+
+/**
+ * 异步哈希结果
+ */
+struct SHA1AsyncResult {
+	int status; ///< shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaBadParam / shaFileError
+	uint64_t length; ///< 参与计算的数据长度
+	SHA1Digest digest; ///< SHA1 摘要
+};
+
+/**
+ * @class SHA1HashAwaitable
+ * @brief SHA1HashExecutor::hash() / hashFile() 返回的可等待对象, co_await 的结果为 SHA1AsyncResult
+ *
+ * @note 可等待对象本身就是提交给执行器的请求节点, 挂起期间保存在协程帧中, 提交请求不需要额外分配内存
+ */
+class SHA1HashAwaitable {
+public:
+	/** 协程恢复方式: 把协程句柄投递到调用者的执行器上恢复 */
+	typedef std::function<void(std::coroutine_handle<>)> Resumer;
+
+private:
+	friend class SHA1HashExecutor;
+
+	SHA1HashExecutor *executor;
+	Resumer resumer;
+	std::coroutine_handle<> continuation;
+	const uint8_t *data; ///< 内存请求的数据, 文件请求时为 NULL
+	int fd; ///< 文件请求的文件描述符
+	bool stream; ///< 文件描述符不可定位(管道/套接字等), 使用 read() 顺序读取
+	uint64_t offset; ///< 下一次读取的位置(内存请求为相对 data 的偏移, 文件请求为文件偏移)
+	uint64_t remaining; ///< 尚未计算的长度
+	std::unique_ptr<SHA1> hasher; ///< 大请求跨时间片保存的中间状态
+	SHA1AsyncResult result;
+
+	SHA1HashAwaitable(SHA1HashExecutor *executor, Resumer resumer);
+
+public:
+	SHA1HashAwaitable(SHA1HashAwaitable&&) = default;
+	SHA1HashAwaitable(const SHA1HashAwaitable&) = delete;
+	SHA1HashAwaitable& operator=(const SHA1HashAwaitable&) = delete;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+	bool await_suspend(std::coroutine_handle<> handle);
+	SHA1AsyncResult await_resume() noexcept {
+		return result;
+	}
+};
+
+/**
+ * @class SHA1HashExecutor
+ * @brief 专用的 SHA1 哈希执行器
+ */
+class SHA1HashExecutor {
+private:
+	friend class SHA1HashAwaitable;
+
+	size_t smallLimit;
+	size_t sliceSize;
+	std::vector<std::thread> workers;
+	std::deque<SHA1HashAwaitable *> smallQueue;
+	std::deque<SHA1HashAwaitable *> largeQueue;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping;
+
+	void submit(SHA1HashAwaitable *request);
+	void workerLoop();
+	bool runSlice(SHA1HashAwaitable *request, size_t budget);
+	void complete(SHA1HashAwaitable *request);
+
+public:
+	/** 每批最多连续处理的小请求个数 */
+	static const size_t MaxBatch = 64;
+
+	/** 构造函数 */
+	explicit SHA1HashExecutor(unsigned int threads = 1, ///< 哈希工作线程数, 0 表示按 std::thread::hardware_concurrency()
+			size_t smallLimit = 64 * 1024, ///< 不超过该长度的请求视为小请求, 优先处理且不切片
+			size_t sliceSize = 1024 * 1024 ///< 大请求每个时间片计算的字节数
+			);
+
+	/** 析构函数: 处理完已提交的请求后回收工作线程 */
+	~SHA1HashExecutor();
+
+	SHA1HashExecutor(const SHA1HashExecutor&) = delete;
+	SHA1HashExecutor& operator=(const SHA1HashExecutor&) = delete;
+
+	/** 异步计算内存缓冲区的 SHA1 摘要 */
+	SHA1HashAwaitable hash(const uint8_t data[], ///< 数据
+			size_t length, ///< 数据长度
+			SHA1HashAwaitable::Resumer resumer = SHA1HashAwaitable::Resumer() ///< 可选: 协程恢复方式
+			);
+
+	/**
+	 * 异步计算文件内容的 SHA1 摘要
+	 *
+	 * @details 普通文件等可定位的描述符使用 pread() 读取, 不改变文件描述符的当前偏移;
+	 * 管道、套接字等不可定位的描述符从当前位置用 read() 顺序读取到 EOF 或 length 字节,
+	 * 此时 offset 必须为 0(否则结果为 shaBadParam). 非阻塞描述符暂无数据时请求让出工作线程,
+	 * 稍后轮转回来继续读取; 阻塞描述符会占用一个工作线程直到数据到达.
+	 */
+	SHA1HashAwaitable hashFile(int fd, ///< 文件描述符
+			uint64_t offset = 0, ///< 起始偏移
+			uint64_t length = ~(uint64_t) 0, ///< 长度, 默认读到文件末尾
+			SHA1HashAwaitable::Resumer resumer = SHA1HashAwaitable::Resumer() ///< 可选: 协程恢复方式
+			);
+};
+
+#endif//_SHA1_ASYNC_HPP_
@@ -0,0 +1,278 @@
+#include "SHA1Chunker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+/**
+ * 内部结构体: 已切分但尚未输出的分块(多线程模式)
+ */
+struct SHA1Chunker::PendingChunk {
+	SHA1ChunkRecord record;
+	std::vector<uint8_t> head; ///< 跨越输入缓冲区的分块在之前输入中的部分(通常为空)
+	const uint8_t *tail; ///< 分块位于调用者本次输入缓冲区中的部分, 原位计算不复制
+	size_t tailLength;
+	std::future<void> done;
+};
+
+// ===========================================================================
+// Gear 滚动哈希
+// ===========================================================================
+
+/**
+ * Gear 查找表: 每个字节值对应一个 64 位随机数
+ *
+ * @note 使用固定种子的 SplitMix64 生成, 保证同样的数据在任何机器上切分结果相同
+ */
+struct GearTable {
+	uint64_t value[256];
+
+	GearTable() {
+		uint64_t seed = 0x5348413143444321ULL; // "SHA1CDC!"
+		for (int i = 0; i < 256; i++) {
+			uint64_t z;
+
+			seed += 0x9E3779B97F4A7C15ULL;
+			z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			value[i] = z ^ (z >> 31);
+		}
+	}
+};
+
+static const GearTable gear;
+
+/**
+ * 取 64 位整数的最高 bits 个比特作为掩码
+ *
+ * @note Gear 哈希每步左移一位, 第 k 位只与最近 k+1 个字节有关, 因此判定边界时使用高位
+ */
+static uint64_t highBitsMask(unsigned int bits) {
+	if (bits == 0) {
+		return 0;
+	}
+	if (bits >= 64) {
+		return ~(uint64_t) 0;
+	}
+	return (~(uint64_t) 0) << (64 - bits);
+}
+
+static unsigned int floorLog2(uint32_t x) {
+	unsigned int n = 0;
+
+	while (x >>= 1) {
+		n++;
+	}
+	return n;
+}
+
+static SHA1ChunkerParameters normalizeParameters(const SHA1ChunkerParameters& in) {
+	SHA1ChunkerParameters out = in;
+
+	out.minSize = std::max<uint32_t>(out.minSize, 64);
+	out.maxSize = std::max(out.maxSize, out.minSize);
+	out.avgSize = std::min(std::max(out.avgSize, out.minSize), out.maxSize);
+	out.avgSize = (uint32_t) 1 << floorLog2(out.avgSize); // 取整为 2 的整数次幂
+	if (out.avgSize < out.minSize) {
+		out.minSize = out.avgSize; // 仅当 minSize 本身不是 2 的整数次幂时出现
+	}
+	return out;
+}
+
+// ===========================================================================
+// SHA1Chunker
+// ===========================================================================
+
+SHA1Chunker::SHA1Chunker(const SHA1ChunkerParameters& parameters,
+		RecordCallback callback,
+		unsigned int workers) :
+		gearHash(0), streamOffset(0), chunkLength(0), callback(callback), chunkStart(NULL), maxInFlight(0) {
+	SHA1ChunkerParameters p;
+	unsigned int bits;
+
+	p = normalizeParameters(parameters);
+	minSize = p.minSize;
+	avgSize = p.avgSize;
+	maxSize = p.maxSize;
+
+	/* 归一化分块(normalization level 2): 平均长度前后分别多/少判定 2 个比特 */
+	bits = floorLog2(avgSize);
+	maskS = highBitsMask(bits + 2);
+	maskL = highBitsMask(bits - 2);
+
+	if (workers > 0) {
+		pool.reset(new SHA1ThreadPool(workers));
+		maxInFlight = 4 * (size_t) workers; // 限制在途分块数, 避免扫描远远领先于哈希计算
+	} else {
+		inlineHasher.reset(new SHA1);
+	}
+}
+
+SHA1Chunker::~SHA1Chunker() {
+	inFlight.clear(); // 在途任务持有各自分块的 shared_ptr, 此处只释放本地引用
+	pool.reset(); // 等待工作线程执行完剩余任务
+}
+
+SHA1ChunkerParameters SHA1Chunker::getParameters() const {
+	return SHA1ChunkerParameters(minSize, avgSize, maxSize);
+}
+
+int SHA1Chunker::checkParameters(const SHA1ChunkerParameters& parameters) {
+	SHA1ChunkerParameters p;
+
+	p = normalizeParameters(parameters);
+	if (p.minSize != parameters.minSize || p.avgSize != parameters.avgSize || p.maxSize != parameters.maxSize) {
+		return shaBadParam;
+	}
+	return shaSuccess;
+}
+
+/*
+ * 在 data[0..length) 中寻找当前分块的结束位置
+ *
+ * 返回属于当前分块的字节数; 若在这些字节内找到了边界则 *boundary 置为 true.
+ * 前 minSize 字节直接跳过不计算滚动哈希(FastCDC 的 cut-point skipping).
+ */
+size_t SHA1Chunker::scan(const uint8_t *data, size_t length, bool *boundary) {
+	const uint64_t *table = gear.value;
+	uint64_t h;
+	size_t n, limit;
+
+	*boundary = false;
+	limit = std::min(length, (size_t) (maxSize - chunkLength));
+	n = 0;
+	if (chunkLength < minSize) {
+		n = std::min(limit, (size_t) (minSize - chunkLength));
+	}
+	h = gearHash;
+	{
+		size_t normal = std::min(limit, (chunkLength < avgSize) ? (size_t) (avgSize - chunkLength) : 0);
+		for (; n < normal; n++) {
+			h = (h << 1) + table[data[n]];
+			if (!(h & maskS)) {
+				*boundary = true;
+				gearHash = h;
+				return n + 1;
+			}
+		}
+	}
+	for (; n < limit; n++) {
+		h = (h << 1) + table[data[n]];
+		if (!(h & maskL)) {
+			*boundary = true;
+			gearHash = h;
+			return n + 1;
+		}
+	}
+	gearHash = h;
+	if (chunkLength + n == maxSize) {
+		*boundary = true;
+	}
+	return n;
+}
+
+/*
+ * 输出当前分块
+ *
+ * 多线程模式下分块由 chunkData 中保存的前一部分和本次输入缓冲区中的 [chunkStart, end) 组成.
+ */
+void SHA1Chunker::emitChunk(const uint8_t *end) {
+	SHA1ChunkRecord record;
+
+	if (chunkLength == 0) {
+		return;
+	}
+	record.offset = streamOffset;
+	record.length = chunkLength;
+	streamOffset += chunkLength;
+	chunkLength = 0;
+	gearHash = 0;
+
+	if (inlineHasher) {
+		inlineHasher->inputEnd();
+		inlineHasher->getHashResult(record.digest);
+		inlineHasher->reset();
+		callback(record);
+		return;
+	}
+
+	std::shared_ptr<PendingChunk> chunk(new PendingChunk);
+	std::shared_ptr<std::packaged_task<void()> > task;
+
+	chunk->record = record;
+	chunk->head.swap(chunkData);
+	chunk->tail = chunkStart;
+	chunk->tailLength = end - chunkStart;
+	chunkStart = end;
+	task = std::make_shared<std::packaged_task<void()> >([chunk]() {
+		SHA1 hasher;
+
+		if (!chunk->head.empty()) {
+			hasher.inputData(chunk->head.data(), (unsigned int) chunk->head.size());
+		}
+		if (chunk->tailLength > 0) {
+			hasher.inputData(chunk->tail, (unsigned int) chunk->tailLength);
+		}
+		hasher.inputEnd();
+		hasher.getHashResult(chunk->record.digest);
+		std::vector<uint8_t>().swap(chunk->head);
+	});
+	chunk->done = task->get_future();
+	inFlight.push_back(chunk);
+	pool->post([task]() { (*task)(); });
+	drain(false);
+}
+
+/*
+ * 按偏移顺序输出已完成的分块记录
+ *
+ * wait 为 false 时只输出已经完成的队首分块, 但在途分块达到上限时会阻塞等待队首完成;
+ * wait 为 true 时等待全部在途分块完成.
+ */
+void SHA1Chunker::drain(bool wait) {
+	while (!inFlight.empty()) {
+		std::shared_ptr<PendingChunk> chunk = inFlight.front();
+
+		if (!wait && inFlight.size() < maxInFlight
+				&& chunk->done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			break;
+		}
+		chunk->done.get();
+		inFlight.pop_front();
+		callback(chunk->record);
+	}
+}
+
+void SHA1Chunker::inputData(const uint8_t data[], size_t length) {
+	chunkStart = data;
+	while (length > 0) {
+		bool boundary;
+		size_t n;
+
+		n = scan(data, length, &boundary);
+		if (inlineHasher) {
+			inlineHasher->inputData(data, (unsigned int) n); // 刚扫描过的数据仍在缓存中
+		}
+		chunkLength += (uint32_t) n;
+		data += n;
+		length -= n;
+		if (boundary) {
+			emitChunk(data);
+		}
+	}
+	if (pool) {
+		/* 未结束的分块只保存本次输入中的部分, 在途分块引用调用者的缓冲区, 返回前必须全部完成 */
+		chunkData.insert(chunkData.end(), chunkStart, data);
+		drain(true);
+	}
+	chunkStart = NULL;
+}
+
+void SHA1Chunker::inputEnd() {
+	emitChunk(chunkStart);
+	if (pool) {
+		drain(true);
+	}
+	streamOffset = 0; // 准备处理下一个数据流
+}
@@ -0,0 +1,141 @@
+/**
+* @file SHA1Chunker.hpp
+* @brief 基于内容分块(CDC)并计算各分块 SHA1 摘要的流水线 C++ 语言头文件
+*
+* @details
+* 使用 Gear 滚动哈希(FastCDC 风格, 带归一化分块)在数据流中寻找分块边界,
+* 并对每个分块计算 SHA1 摘要, 输出 (偏移, 长度, 摘要) 记录, 用于备份去重.
+*
+* - 单线程模式(workers = 0): 每扫描完一段数据就立即把这段数据送入当前分块的
+*   SHA1 计算器, 边界扫描与摘要计算在同一遍内存访问中完成, 数据不会被读两遍.
+* - 多线程模式(workers > 0): 扫描线程只负责切分, 工作线程直接在调用者的缓冲区中原位
+*   并行计算各分块的摘要, 记录仍按偏移顺序在调用者线程中回调输出. 只有跨越两次
+*   inputData() 调用的分块会把前一次输入中的部分复制保存; inputData() 返回前会等待
+*   本次输入涉及的分块全部计算完成, 调用者随后可以立即复用缓冲区.
+*
+* @see FastCDC: a Fast and Efficient Content-Defined Chunking Approach for Data Deduplication (USENIX ATC 2016)
+*
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+* @example example_chunker.cpp 是一个分块去重的 C++ 示例程序
+*/
+
+#ifndef _SHA1_CHUNKER_HPP_
+#define _SHA1_CHUNKER_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1.hpp"
+#include "SHA1ThreadPool.hpp"
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+/**
+ * 分块参数
+ *
+ * @note 要求 64 <= minSize <= avgSize <= maxSize; avgSize 按 2 的整数次幂取整
+ */
+struct SHA1ChunkerParameters {
+	uint32_t minSize; ///< 最小分块长度(字节), 小于该长度的位置不做边界判定
+	uint32_t avgSize; ///< 期望平均分块长度(字节)
+	uint32_t maxSize; ///< 最大分块长度(字节), 达到该长度时强制切分
+
+	/** 默认参数: 2 KiB / 8 KiB / 64 KiB */
+	SHA1ChunkerParameters() :
+			minSize(2048), avgSize(8192), maxSize(65536) {
+	}
+	SHA1ChunkerParameters(uint32_t minimum, uint32_t average, uint32_t maximum) :
+			minSize(minimum), avgSize(average), maxSize(maximum) {
+	}
+};
+
+/**
+ * 分块记录
+ */
+struct SHA1ChunkRecord {
+	uint64_t offset; ///< 分块在数据流中的起始偏移
+	uint32_t length; ///< 分块长度
+	uint8_t digest[SHA1HashSize]; ///< 分块的 SHA1 摘要
+};
+
+/**
+ * @class SHA1Chunker
+ * @brief 内容定义分块 + SHA1 指纹计算流水线
+ */
+class SHA1Chunker {
+public:
+	typedef std::function<void(const SHA1ChunkRecord&)> RecordCallback;
+
+private:
+	struct PendingChunk;
+
+	uint32_t minSize;
+	uint32_t avgSize;
+	uint32_t maxSize;
+	uint64_t maskS; ///< 平均长度之前使用的严格掩码(比特数更多, 不易切分)
+	uint64_t maskL; ///< 平均长度之后使用的宽松掩码(比特数更少, 容易切分)
+
+	uint64_t gearHash; ///< 当前分块的滚动哈希值
+	uint64_t streamOffset; ///< 当前分块的起始偏移
+	uint32_t chunkLength; ///< 当前分块已扫描的长度
+
+	RecordCallback callback;
+	std::unique_ptr<SHA1ThreadPool> pool;
+	std::unique_ptr<SHA1> inlineHasher; ///< 单线程模式下当前分块的 SHA1 计算器
+	std::vector<uint8_t> chunkData; ///< 多线程模式下当前分块在之前的 inputData() 调用中已扫描的数据
+	const uint8_t *chunkStart; ///< 多线程模式下当前分块在本次输入缓冲区中的起始位置
+	std::deque<std::shared_ptr<PendingChunk> > inFlight; ///< 多线程模式下按偏移顺序排列的未输出分块
+	size_t maxInFlight;
+
+	size_t scan(const uint8_t *data, size_t length, bool *boundary);
+	void emitChunk(const uint8_t *end);
+	void drain(bool wait);
+
+public:
+	/**
+	 * 构造函数
+	 *
+	 * @note 参数不合法时会被修正到最接近的合法值, 可通过 getParameters() 查询实际使用的参数
+	 */
+	SHA1Chunker(const SHA1ChunkerParameters& parameters, ///< 分块参数
+			RecordCallback callback, ///< 每输出一个分块记录回调一次(总在调用者线程中按偏移顺序回调)
+			unsigned int workers = 0 ///< 并行哈希工作线程数, 0 表示在扫描线程内同遍计算
+			);
+
+	/** 析构函数 */
+	~SHA1Chunker();
+
+	SHA1Chunker(const SHA1Chunker&) = delete;
+	SHA1Chunker& operator=(const SHA1Chunker&) = delete;
+
+	/**
+	 * 输入数据
+	 *
+	 * @note 多线程模式下本函数返回时, 本次输入中已切分出的分块均已完成摘要计算并回调输出
+	 */
+	void inputData(const uint8_t data[], ///< 输入数据
+			size_t length ///< 输入数据长度
+			);
+
+	/** 结束输入: 输出最后一个(可能小于 minSize 的)分块并等待全部记录回调完成 */
+	void inputEnd();
+
+	/** 查询实际使用的分块参数 */
+	SHA1ChunkerParameters getParameters() const;
+
+	/**
+	 * 检查分块参数
+	 *
+	 * @return shaSuccess=0 表示参数可直接使用, shaBadParam 表示参数会被修正
+	 */
+	static int checkParameters(const SHA1ChunkerParameters& parameters ///< 分块参数
+			);
+};
+
+#endif//_SHA1_CHUNKER_HPP_
@@ -0,0 +1,350 @@
+#include "SHA1Client.hpp"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ===========================================================================
+// SHA1Client
+// ===========================================================================
+
+SHA1Client::SHA1Client() :
+		socketFd(-1), nextId(1) {
+}
+
+SHA1Client::~SHA1Client() {
+	disconnect();
+}
+
+int SHA1Client::connect(const char *socketPath, uid_t trustedUid) {
+	struct sockaddr_un addr;
+	struct ucred peer;
+	socklen_t peerLength = sizeof(peer);
+	std::string defaultPath;
+	int fd;
+
+	if (!socketPath || !*socketPath) {
+		defaultPath = SHA1DaemonDefaultSocket();
+		socketPath = defaultPath.c_str();
+	}
+	if (trustedUid == (uid_t) -1) {
+		trustedUid = getuid();
+	}
+	if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+		return shaBadParam;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socketPath);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	if (::connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return shaFileError;
+	}
+	/* 套接字可能是其他用户抢先创建的, 确认对端身份之前不发送任何文件描述符 */
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peerLength) != 0 || peer.uid != trustedUid) {
+		close(fd);
+		return shaFileError;
+	}
+	disconnect();
+	socketFd = fd;
+	return shaSuccess;
+}
+
+void SHA1Client::disconnect() {
+	if (socketFd >= 0) {
+		close(socketFd);
+		socketFd = -1;
+	}
+}
+
+bool SHA1Client::isConnected() const {
+	return socketFd >= 0;
+}
+
+int SHA1Client::sendRequest(int fd, uint64_t offset, uint64_t length, uint64_t id) {
+	SHA1DaemonRequest request;
+	union {
+		char buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	memset(&request, 0, sizeof(request));
+	request.magic = SHA1DaemonMagic;
+	request.id = id;
+	request.offset = offset;
+	request.length = length;
+
+	iov.iov_base = &request;
+	iov.iov_len = sizeof(request);
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	for (;;) {
+		if (sendmsg(socketFd, &msg, MSG_NOSIGNAL) == (ssize_t) sizeof(request)) {
+			return shaSuccess;
+		}
+		if (errno != EINTR) {
+			return shaFileError;
+		}
+	}
+}
+
+int SHA1Client::receiveReply(SHA1DaemonReply *reply) {
+	for (;;) {
+		ssize_t n;
+
+		n = recv(socketFd, reply, sizeof(*reply), 0);
+		if (n == (ssize_t) sizeof(*reply) && reply->magic == SHA1DaemonMagic) {
+			return shaSuccess;
+		}
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		return shaFileError;
+	}
+}
+
+int SHA1Client::hashFd(int fd, uint64_t offset, uint64_t length, SHA1Digest *digest, uint64_t *hashedLength) {
+	SHA1DaemonReply reply;
+	int err;
+
+	if (!digest) {
+		return shaNull;
+	}
+	if (socketFd < 0) {
+		return shaStateError;
+	}
+	err = sendRequest(fd, offset, length, nextId++);
+	if (!err) {
+		err = receiveReply(&reply);
+	}
+	if (err) {
+		disconnect(); // 通信出错后连接状态未知, 不再继续使用
+		return err;
+	}
+	if (reply.status == shaSuccess) {
+		memcpy(digest->bytes, reply.digest, SHA1HashSize);
+		if (hashedLength) {
+			*hashedLength = reply.length;
+		}
+	}
+	return reply.status;
+}
+
+int SHA1Client::hashFile(const char *path, SHA1Digest *digest) {
+	int fd;
+	int err;
+
+	if (!path || !digest) {
+		return shaNull;
+	}
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	err = hashFd(fd, 0, SHA1DaemonToEnd, digest);
+	close(fd);
+	return err;
+}
+
+/*
+ * 应答按守护进程的完成顺序到达, 请求 ID 为 base + 序号, 据此写回对应位置
+ */
+int SHA1Client::hashBatch(const int fds[], size_t n, SHA1Digest digests[], int status[]) {
+	uint64_t base;
+	size_t sent = 0, received = 0;
+
+	if ((!fds || !digests || !status) && n) {
+		return shaNull;
+	}
+	if (socketFd < 0) {
+		return shaStateError;
+	}
+	base = nextId;
+	nextId += n;
+	while (received < n) {
+		SHA1DaemonReply reply;
+		uint64_t index;
+		int err;
+
+		while (sent < n && sent - received < MaxInFlight) {
+			err = sendRequest(fds[sent], 0, SHA1DaemonToEnd, base + sent);
+			if (err) {
+				disconnect();
+				return err;
+			}
+			sent++;
+		}
+		err = receiveReply(&reply);
+		if (err) {
+			disconnect();
+			return err;
+		}
+		index = reply.id - base;
+		if (reply.id < base || index >= sent) {
+			disconnect();
+			return shaFileError;
+		}
+		status[index] = reply.status;
+		memcpy(digests[index].bytes, reply.digest, SHA1HashSize);
+		received++;
+	}
+	return shaSuccess;
+}
+
+// ===========================================================================
+// SHA1Remote
+// ===========================================================================
+
+SHA1Remote::SHA1Remote(SHA1Client& client) :
+		client(client), memfd(-1), total(0), error(shaSuccess), mapping(NULL), mappingLength(0) {
+}
+
+SHA1Remote::~SHA1Remote() {
+	reset();
+}
+
+bool SHA1Remote::createMemfd() {
+	if (memfd < 0) {
+		memfd = memfd_create("sha1-remote", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (memfd < 0) {
+			error = shaFileError;
+			return false;
+		}
+	}
+	return true;
+}
+
+void SHA1Remote::unmapBuffer() {
+	if (mapping) {
+		munmap(mapping, mappingLength);
+		mapping = NULL;
+		mappingLength = 0;
+	}
+}
+
+/* 用 pwrite() 写在 total 处: inputBuffer() 扩展文件长度时不移动文件偏移 */
+void SHA1Remote::inputData(const uint8_t data[], unsigned int length) {
+	if (error || length == 0 || !createMemfd()) {
+		return;
+	}
+	while (length > 0) {
+		ssize_t n;
+
+		n = pwrite(memfd, data, length, (off_t) total);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			error = shaFileError;
+			return;
+		}
+		data += n;
+		length -= (unsigned int) n;
+		total += (uint64_t) n;
+	}
+}
+
+/*
+ * F_SEAL_SHRINK 只禁止缩小, 封印后仍可用 ftruncate() 扩展文件;
+ * mmap() 的偏移必须按页对齐, 因此从 total 所在页的起点开始映射.
+ */
+uint8_t *SHA1Remote::inputBuffer(size_t length) {
+	uint64_t start;
+	void *p;
+
+	unmapBuffer();
+	if (error || length == 0 || !createMemfd()) {
+		return NULL;
+	}
+	if (ftruncate(memfd, (off_t) (total + length)) != 0) {
+		error = shaFileError;
+		return NULL;
+	}
+	start = total & ~(uint64_t) (sysconf(_SC_PAGESIZE) - 1);
+	p = mmap(NULL, (size_t) (total + length - start), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, (off_t) start);
+	if (p == MAP_FAILED) {
+		error = shaFileError;
+		return NULL;
+	}
+	mapping = p;
+	mappingLength = (size_t) (total + length - start);
+	total += length;
+	return (uint8_t *) p + (mappingLength - length);
+}
+
+uint64_t SHA1Remote::getTotalDataBits() {
+	return total * 8;
+}
+
+void SHA1Remote::inputEnd() {
+	/* 结束数据输入: 数据已全部写入 memfd, 此处无额外处理 */
+}
+
+/*
+ * 提交前封印 F_SEAL_SHRINK, 守护进程据此直接映射共享内存;
+ * 封印后仍可追加数据, 因此取结果后还可以继续输入.
+ */
+int SHA1Remote::getHashResult(uint8_t digest[SHA1HashSize]) {
+	SHA1Digest d;
+	int err;
+
+	unmapBuffer();
+	if (error) {
+		return error;
+	}
+	if (memfd < 0) {
+		/* 尚未输入任何数据: 空消息的摘要不需要守护进程计算 */
+		static const uint8_t empty[SHA1HashSize] = {
+			0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d, 0x32, 0x55,
+			0xbf, 0xef, 0x95, 0x60, 0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09,
+		};
+		memcpy(digest, empty, SHA1HashSize);
+		return shaSuccess;
+	}
+	(void) fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK);
+	err = client.hashFd(memfd, 0, total, &d);
+	if (!err) {
+		memcpy(digest, d.bytes, SHA1HashSize);
+	}
+	return err;
+}
+
+int SHA1Remote::getHashResult(SHA1Digest& digest) {
+	return getHashResult(digest.bytes);
+}
+
+void SHA1Remote::reset() {
+	unmapBuffer();
+	if (memfd >= 0) {
+		close(memfd); // 已封印的 memfd 不能截断, 下次输入时重新创建
+		memfd = -1;
+	}
+	total = 0;
+	error = shaSuccess;
+}
@@ -0,0 +1,181 @@
+/**
+* @file SHA1Client.hpp
+* @brief SHA1 哈希守护进程客户端 C++ 语言头文件
+*
+* @details
+* - SHA1Client: 与守护进程(sha1d)的连接, 传递文件描述符请求计算摘要, 支持批量流水线提交;
+* - SHA1Remote: 与 SHA1 类相同风格的 inputData()/getHashResult() 接口,
+*   输入数据写入 memfd 共享内存, 取结果时把 memfd 交给守护进程计算.
+*
+* 复制次数: SHA1Remote::inputData() 把调用者的数据复制一次到 memfd;
+* SHA1Remote::inputBuffer() 返回 memfd 的可写映射, 调用者直接在共享内存中生成数据, 没有复制;
+* 已有的文件或调用者自行创建的 memfd 用 SHA1Client::hashFd() 提交, 同样没有复制.
+*
+* @see SHA1Daemon.hpp
+* @note 仅支持 Linux
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+* @example example_client.cpp 是一个通过守护进程计算 SHA1 的 C++ 示例程序
+*/
+
+#ifndef _SHA1_CLIENT_HPP_
+#define _SHA1_CLIENT_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1Daemon.hpp"
+#include "SHA1Digest.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @class SHA1Client
+ * @brief 守护进程连接
+ */
+class SHA1Client {
+private:
+	int socketFd;
+	uint64_t nextId;
+
+	int sendRequest(int fd, uint64_t offset, uint64_t length, uint64_t id);
+	int receiveReply(SHA1DaemonReply *reply);
+
+public:
+	/** 批量提交时最多同时在途的请求个数 */
+	static const size_t MaxInFlight = 64;
+
+	/** 构造函数 */
+	SHA1Client();
+
+	/** 析构函数: 断开连接 */
+	~SHA1Client();
+
+	SHA1Client(const SHA1Client&) = delete;
+	SHA1Client& operator=(const SHA1Client&) = delete;
+
+	/**
+	 * 连接守护进程
+	 *
+	 * @details 连接后用 SO_PEERCRED 取得监听进程的用户, 与 trustedUid 不符时断开,
+	 * 不会向其他用户的进程发送任何文件描述符.
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaBadParam(路径过长) / shaFileError(连接失败或对端用户不符)
+	 */
+	int connect(const char *socketPath = NULL, ///< 套接字路径, NULL 表示按 SHA1DaemonDefaultSocket()
+			uid_t trustedUid = (uid_t) -1 ///< 守护进程应属于的用户, (uid_t) -1 表示当前用户
+			);
+
+	/** 断开连接 */
+	void disconnect();
+
+	/** 是否已连接 */
+	bool isConnected() const;
+
+	/**
+	 * 计算文件描述符指定区间的摘要
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaStateError(未连接) / shaBadParam / shaFileError
+	 */
+	int hashFd(int fd, ///< 文件描述符(普通文件或 memfd)
+			uint64_t offset, ///< 起始偏移
+			uint64_t length, ///< 长度, SHA1DaemonToEnd 表示到文件末尾
+			SHA1Digest *digest, ///< 输出摘要
+			uint64_t *hashedLength = NULL ///< 可选输出: 实际参与计算的长度
+			);
+
+	/**
+	 * 计算文件的摘要
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaStateError(未连接) / shaFileError
+	 */
+	int hashFile(const char *path, ///< 文件名
+			SHA1Digest *digest ///< 输出摘要
+			);
+
+	/**
+	 * 批量计算多个完整文件的摘要
+	 *
+	 * @details 请求以流水线方式连续发送(最多 MaxInFlight 个在途), 守护进程可以同时计算
+	 * @return shaSuccess=0 表示通信正常(各文件的结果见 status[]), 其他非 0 值表示错误: shaNull / shaStateError / shaFileError
+	 */
+	int hashBatch(const int fds[], ///< 文件描述符数组
+			size_t n, ///< 个数
+			SHA1Digest digests[], ///< 输出摘要
+			int status[] ///< 输出各文件的结果, 含义同 hashFd() 的返回值
+			);
+};
+
+/**
+ * @class SHA1Remote
+ * @brief 通过守护进程计算的 SHA1 计算器, 接口与 SHA1 类相同
+ */
+class SHA1Remote {
+private:
+	SHA1Client& client;
+	int memfd; ///< 保存已输入数据的 memfd, 尚未输入数据时为 -1
+	uint64_t total; ///< 已输入的字节数
+	int error; ///< 写入 memfd 失败时记录的错误
+	void *mapping; ///< inputBuffer() 返回的映射(按页对齐), 没有时为 NULL
+	size_t mappingLength;
+
+	bool createMemfd();
+	void unmapBuffer();
+
+public:
+	/** 构造函数 */
+	explicit SHA1Remote(SHA1Client& client ///< 已连接的客户端
+			);
+
+	/** 析构函数 */
+	~SHA1Remote();
+
+	SHA1Remote(const SHA1Remote&) = delete;
+	SHA1Remote& operator=(const SHA1Remote&) = delete;
+
+	/**
+	 * 输入数据
+	 *
+	 * @note 数据被复制一次到 memfd; 需要避免复制时使用 inputBuffer()
+	 */
+	void inputData(const uint8_t data[], ///< 输入数据
+			unsigned int length ///< 输入数据长度
+			);
+
+	/**
+	 * 在 memfd 末尾追加 length 字节, 返回其可写映射, 由调用者直接填入输入数据(不经过复制)
+	 *
+	 * @details 这 length 字节立即计入输入, 可以与 inputData() 交替使用.
+	 * 返回的指针在下一次调用 inputBuffer() / getHashResult() / reset() 之前有效, 调用者须在此之前写完数据.
+	 * @return 可写缓冲区; 失败时返回 NULL, 之后的 getHashResult() 返回 shaFileError
+	 */
+	uint8_t *inputBuffer(size_t length ///< 追加的长度
+			);
+
+	/**
+	 * 查询累计输入数据的比特数
+	 *
+	 * @return 累计输入数据总比特数. (注: 8比特=1字节)
+	 */
+	uint64_t getTotalDataBits();
+
+	/** 结束输入 */
+	void inputEnd();
+
+	/**
+	 * 取出哈希摘要结果
+	 *
+	 * @details 与 SHA1 类相同, 取结果后仍可继续输入数据
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaStateError(未连接) / shaFileError
+	 */
+	int getHashResult(uint8_t digest[SHA1HashSize] ///< 输出 SHA1 摘要
+			);
+	int getHashResult(SHA1Digest& digest ///< 输出 SHA1 摘要
+			);
+
+	/** 清除当前运算结果和所有中间数据 */
+	void reset();
+};
+
+#endif//_SHA1_CLIENT_HPP_
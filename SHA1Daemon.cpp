@@ -0,0 +1,458 @@
+#include "SHA1Daemon.hpp"
+#include "SHA1.hpp"
+#include "SHA1FileInput.hpp"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** 每条请求消息最多接收的文件描述符个数(多余的会被关闭并返回错误) */
+static const int kMaxFds = 4;
+
+/** 每个连接已接收而应答尚未发出的请求上限(与 SHA1Client::MaxInFlight 相同); 每个请求都占用一个收到的文件描述符 */
+static const size_t kMaxPending = 64;
+
+/** accept() 因文件描述符耗尽失败后, 暂停接受新连接的时间(毫秒) */
+static const int kAcceptRetryMs = 100;
+
+/**
+ * 内部结构体: 一个客户端连接
+ *
+ * @note 工作线程通过 shared_ptr 持有连接, 客户端断开后套接字在最后一个请求完成时才关闭
+ */
+struct SHA1Daemon::Connection {
+	int fd;
+	int wakeFd;
+	std::mutex mutex;
+	std::deque<SHA1DaemonReply> replies; ///< 等待发送的应答
+	size_t pending; ///< 已接收而应答尚未发出的请求数(包括正在计算的)
+
+	Connection(int fd, int wakeFd) :
+			fd(fd), wakeFd(wakeFd), pending(0) {
+	}
+
+	~Connection() {
+		close(fd);
+	}
+
+	/* 是否还可以接收新请求 */
+	bool readable() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return pending < kMaxPending;
+	}
+
+	/* 是否有等待发送的应答 */
+	bool writable() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return !replies.empty();
+	}
+
+	/* 接收到一个请求 */
+	void accepted() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		pending++;
+	}
+
+	/* 应答放入发送队列; wakeup 为 true 时(工作线程调用)唤醒 run() 发送 */
+	void push(const SHA1DaemonReply& reply, bool wakeup) {
+		char c = 1;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			replies.push_back(reply);
+		}
+		if (wakeup) {
+			(void) write(wakeFd, &c, 1); // 管道已满(EAGAIN)时 run() 同样会被唤醒
+		}
+	}
+
+	/*
+	 * 以非阻塞方式发送队列中的应答, 套接字缓冲区满时留待 POLLOUT 后继续
+	 *
+	 * 返回 false 表示连接已断开或出错.
+	 */
+	bool flush() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		while (!replies.empty()) {
+			if (::send(fd, &replies.front(), sizeof(SHA1DaemonReply), MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			replies.pop_front();
+			pending--;
+		}
+		return true;
+	}
+};
+
+int SHA1Daemon::hashRegion(int fd, uint64_t offset, uint64_t length, uint8_t digest[SHA1HashSize],
+		uint64_t *hashedLength) {
+	SHA1 hasher;
+	struct stat st;
+	uint64_t size;
+	int seals = -1;
+
+	if (fstat(fd, &st) != 0) {
+		return shaFileError;
+	}
+	if (!S_ISREG(st.st_mode)) {
+		return shaBadParam; // memfd 也是 S_ISREG
+	}
+	size = (uint64_t) st.st_size;
+	length = (offset < size) ? std::min(length, size - offset) : 0;
+#if defined(F_GET_SEALS)
+	seals = fcntl(fd, F_GET_SEALS);
+#endif
+
+	if (length > 0 && seals >= 0 && (seals & F_SEAL_SHRINK)) {
+		/* 已封印不能缩短的 memfd: 直接映射共享内存, 零复制 */
+		uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+		uint64_t aligned = offset & ~(page - 1);
+		size_t mapLength = (size_t) (length + (offset - aligned));
+		void *p;
+
+		p = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, fd, (off_t) aligned);
+		if (p == MAP_FAILED) {
+			return shaFileError;
+		}
+		(void) madvise(p, mapLength, MADV_SEQUENTIAL);
+		SHA1InputBuffer(hasher, (const uint8_t *) p + (offset - aligned), length);
+		munmap(p, mapLength);
+	} else if (length > 0) {
+		/* 文件在计算期间被截断时只计算到实际末尾 */
+		if (SHA1InputFd(hasher, fd, offset, length, false, &length) != shaSuccess) {
+			return shaFileError;
+		}
+	}
+	hasher.inputEnd();
+	hasher.getHashResult(digest);
+	if (hashedLength) {
+		*hashedLength = length;
+	}
+	return shaSuccess;
+}
+
+// ===========================================================================
+// SHA1Daemon
+// ===========================================================================
+
+SHA1Daemon::WakePipe::WakePipe() {
+	if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+		fds[0] = fds[1] = -1;
+	}
+}
+
+SHA1Daemon::WakePipe::~WakePipe() {
+	if (fds[0] >= 0) {
+		close(fds[0]);
+		close(fds[1]);
+	}
+}
+
+SHA1Daemon::SHA1Daemon(unsigned int threads) :
+		listenFd(-1), stopping(false), pool(threads) {
+}
+
+SHA1Daemon::~SHA1Daemon() {
+	if (listenFd >= 0) {
+		close(listenFd);
+		unlink(socketPath.c_str());
+	}
+}
+
+/*
+ * 检查(必要时创建)套接字所在的目录
+ *
+ * 目录必须属于当前用户或 root; 其他用户可写的目录必须设置粘滞位(如 /tmp), 否则其他用户可以替换套接字.
+ */
+static int prepareSocketDirectory(const char *path) {
+	std::string directory(path);
+	struct stat st;
+	size_t slash;
+
+	slash = directory.rfind('/');
+	if (slash == std::string::npos) {
+		directory = ".";
+	} else {
+		directory.resize(slash ? slash : 1);
+	}
+	if (lstat(directory.c_str(), &st) != 0) {
+		if (errno != ENOENT || mkdir(directory.c_str(), 0700) != 0 || lstat(directory.c_str(), &st) != 0) {
+			return shaFileError;
+		}
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		errno = ENOTDIR;
+		return shaFileError;
+	}
+	if ((st.st_uid != getuid() && st.st_uid != 0) || ((st.st_mode & (S_IWGRP | S_IWOTH)) && !(st.st_mode & S_ISVTX))) {
+		errno = EPERM; // 便于调用者用 perror() 报告原因
+		return shaFileError;
+	}
+	return shaSuccess;
+}
+
+/*
+ * 删除上次运行遗留的套接字文件
+ *
+ * 只删除套接字, 并且先试连接: 连接被拒绝说明没有进程在监听, 才是遗留文件;
+ * 能连上说明另一个守护进程正在使用该路径, 不能删除.
+ */
+static int removeStaleSocket(const struct sockaddr_un& addr) {
+	struct stat st;
+	int fd;
+	int err;
+
+	if (lstat(addr.sun_path, &st) != 0) {
+		return (errno == ENOENT) ? shaSuccess : shaFileError;
+	}
+	if (!S_ISSOCK(st.st_mode)) {
+		errno = EEXIST;
+		return shaFileError;
+	}
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	err = ::connect(fd, (const struct sockaddr *) &addr, sizeof(addr));
+	close(fd);
+	if (err == 0) {
+		errno = EADDRINUSE;
+		return shaFileError;
+	}
+	if (errno != ECONNREFUSED) {
+		return shaFileError;
+	}
+	return (unlink(addr.sun_path) == 0 || errno == ENOENT) ? shaSuccess : shaFileError;
+}
+
+int SHA1Daemon::listen(const char *path) {
+	struct sockaddr_un addr;
+	int fd;
+
+	if (!path) {
+		return shaNull;
+	}
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		return shaBadParam;
+	}
+	if (prepareSocketDirectory(path) != shaSuccess) {
+		return shaFileError;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (removeStaleSocket(addr) != shaSuccess) {
+		return shaFileError;
+	}
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+		close(fd);
+		return shaFileError;
+	}
+	if (listenFd >= 0) {
+		close(listenFd);
+		unlink(socketPath.c_str());
+	}
+	listenFd = fd;
+	socketPath = path;
+	return shaSuccess;
+}
+
+void SHA1Daemon::stop() {
+	char c = 0;
+
+	stopping = true;
+	if (wake.fds[1] >= 0) {
+		(void) write(wake.fds[1], &c, 1);
+	}
+}
+
+void SHA1Daemon::acceptClient() {
+	for (;;) {
+		int fd;
+
+		fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				/*
+				 * EMFILE / ENFILE / ENOMEM 等: 待接受的连接仍在队列中, 监听套接字保持可读,
+				 * 继续 poll() 会立即返回而空转, 因此暂停接受一段时间
+				 */
+				acceptRetry = std::chrono::steady_clock::now() + std::chrono::milliseconds(kAcceptRetryMs);
+			}
+			return;
+		}
+		connections[fd] = std::make_shared<Connection>(fd, wake.fds[1]);
+	}
+}
+
+/*
+ * 读出连接上已到达的请求并提交给线程池, 在途请求达到 kMaxPending 时停止读取
+ *
+ * 返回 false 表示连接已断开或出错, 调用者应将其移除.
+ */
+bool SHA1Daemon::receive(const std::shared_ptr<Connection>& connection) {
+	for (;;) {
+		SHA1DaemonRequest request;
+		SHA1DaemonReply reply;
+		union {
+			char buffer[CMSG_SPACE(sizeof(int) * kMaxFds)];
+			struct cmsghdr align;
+		} control;
+		struct iovec iov;
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		std::vector<int> fds;
+		ssize_t n;
+
+		if (!connection->readable()) {
+			return true; // 其余请求留在套接字中, 应答发出后再读取
+		}
+		iov.iov_base = &request;
+		iov.iov_len = sizeof(request);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+
+		n = recvmsg(connection->fd, &msg, MSG_CMSG_CLOEXEC);
+		if (n < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		if (n == 0) {
+			return false; // 客户端已关闭连接
+		}
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+				size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				const int *p = (const int *) CMSG_DATA(cmsg);
+
+				fds.insert(fds.end(), p, p + count);
+			}
+		}
+
+		connection->accepted();
+		memset(&reply, 0, sizeof(reply));
+		reply.magic = SHA1DaemonMagic;
+		if (n == (ssize_t) sizeof(request)) {
+			reply.id = request.id;
+		}
+		if (n != (ssize_t) sizeof(request) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+				|| request.magic != SHA1DaemonMagic || fds.size() != 1) {
+			for (size_t i = 0; i < fds.size(); i++) {
+				close(fds[i]);
+			}
+			reply.status = shaBadParam;
+			connection->push(reply, false);
+			continue;
+		}
+
+		/* 所有客户端的请求进入同一个线程池队列, 由全部工作线程共同处理 */
+		int fd = fds[0];
+		std::shared_ptr<Connection> owner = connection;
+		pool.post([owner, request, fd, reply]() mutable {
+			reply.status = hashRegion(fd, request.offset, request.length, reply.digest, &reply.length);
+			close(fd);
+			owner->push(reply, true);
+		});
+	}
+}
+
+int SHA1Daemon::run() {
+	if (listenFd < 0 || wake.fds[0] < 0) {
+		return shaStateError;
+	}
+	for (;;) {
+		std::vector<struct pollfd> fds;
+		std::map<int, std::shared_ptr<Connection> >::iterator it;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		struct pollfd pfd;
+		int timeout = -1;
+
+		/* 先发送已完成的应答, 发不完的等待套接字可写 */
+		for (it = connections.begin(); it != connections.end();) {
+			if (it->second->flush()) {
+				++it;
+			} else {
+				it = connections.erase(it);
+			}
+		}
+
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		pfd.fd = wake.fds[0];
+		fds.push_back(pfd);
+		pfd.fd = listenFd;
+		if (now < acceptRetry) {
+			pfd.fd = -1; // poll() 忽略负的描述符
+			timeout = (int) std::chrono::duration_cast<std::chrono::milliseconds>(acceptRetry - now).count() + 1;
+		}
+		fds.push_back(pfd);
+		for (it = connections.begin(); it != connections.end(); ++it) {
+			pfd.fd = it->first;
+			pfd.events = (it->second->readable() ? POLLIN : 0) | (it->second->writable() ? POLLOUT : 0);
+			fds.push_back(pfd);
+		}
+
+		if (poll(fds.data(), fds.size(), timeout) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return shaFileError;
+		}
+		if (fds[0].revents) {
+			char c;
+
+			while (read(wake.fds[0], &c, 1) > 0) {
+			}
+			if (stopping.exchange(false)) {
+				return shaSuccess;
+			}
+		}
+		if (fds[1].revents & POLLIN) {
+			acceptClient();
+		}
+		for (size_t i = 2; i < fds.size(); i++) {
+			if (!fds[i].revents) {
+				continue;
+			}
+			it = connections.find(fds[i].fd);
+			if (it == connections.end()) {
+				continue;
+			}
+			if ((fds[i].revents & POLLIN) && !receive(it->second)) {
+				connections.erase(it);
+			} else if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+				connections.erase(it);
+			}
+		}
+	}
+}
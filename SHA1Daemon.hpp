@@ -0,0 +1,175 @@
+/**
+* @file SHA1Daemon.hpp
+* @brief 本机 SHA1 哈希守护进程 C++ 语言头文件
+*
+* @details
+* 许多短生命周期的进程各自只计算少量文件的摘要时, 每个进程都要单独启动和初始化, 彼此之间也无法合并调度.
+* SHA1Daemon 在 Unix 域套接字上接收所有客户端的请求, 统一交给一个 SHA1ThreadPool 并行计算:
+* - 客户端不发送数据本身, 而是通过 SCM_RIGHTS 传递文件描述符(普通文件或 memfd 共享内存)及偏移和长度;
+* - 对设置了 F_SEAL_SHRINK 的 memfd, 守护进程直接 mmap 共享内存计算, 全程没有数据复制;
+*   其他文件使用 pread() 从页缓存读取(未封印的文件可能被截断, mmap 访问会触发 SIGBUS);
+* - 每个请求对应一个固定长度的 SOCK_SEQPACKET 消息, 应答按完成顺序返回, 以请求 ID 区分;
+*   应答先放入连接的发送队列, 由 run() 在套接字可写时发送, 工作线程不会因客户端不读取而阻塞;
+*   每个连接已接收而应答尚未发出的请求最多 64 个, 达到上限后暂停读取该连接.
+*
+* 客户端库见 SHA1Client.hpp, 守护进程主程序见 sha1d.cpp.
+*
+* 安全: 文件描述符会交给监听套接字的进程, 因此套接字默认放在只有所有者可以访问的目录中
+* (见 SHA1DaemonDefaultSocket()), 客户端连接后还会用 SO_PEERCRED 确认守护进程属于预期的用户.
+*
+* @note 使用 Linux 特有的 memfd 封印(sealing)和 SOCK_SEQPACKET 套接字
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+*/
+
+#ifndef _SHA1_DAEMON_HPP_
+#define _SHA1_DAEMON_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1.h"
+#include "SHA1ThreadPool.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * 默认套接字路径
+ *
+ * @details 依次取:
+ * - 环境变量 SHA1D_SOCKET;
+ * - $XDG_RUNTIME_DIR/sha1d.sock (该目录由系统为每个用户创建, 只有所有者可以访问);
+ * - /tmp/sha1d-<uid>/sha1d.sock (目录由 SHA1Daemon::listen() 以 0700 权限创建).
+ * 不使用公共可写目录下的固定文件名, 以免其他用户抢先创建同名套接字接收文件描述符.
+ */
+inline std::string SHA1DaemonDefaultSocket() {
+	const char *env;
+	char path[64];
+
+	env = getenv("SHA1D_SOCKET");
+	if (env && *env) {
+		return env;
+	}
+	env = getenv("XDG_RUNTIME_DIR");
+	if (env && *env) {
+		return std::string(env) + "/sha1d.sock";
+	}
+	snprintf(path, sizeof(path), "/tmp/sha1d-%u/sha1d.sock", (unsigned int) getuid());
+	return path;
+}
+
+/** 协议消息魔数 */
+static const uint32_t SHA1DaemonMagic = 0x53484131; // "SHA1"
+
+/** 长度字段取该值表示一直计算到文件末尾 */
+static const uint64_t SHA1DaemonToEnd = ~(uint64_t) 0;
+
+/**
+ * 请求消息, 随消息通过 SCM_RIGHTS 附带一个文件描述符
+ */
+struct SHA1DaemonRequest {
+	uint32_t magic; ///< SHA1DaemonMagic
+	uint32_t reserved; ///< 保留, 置 0
+	uint64_t id; ///< 请求 ID, 原样返回
+	uint64_t offset; ///< 起始偏移
+	uint64_t length; ///< 长度, SHA1DaemonToEnd 表示到文件末尾
+};
+
+/**
+ * 应答消息
+ */
+struct SHA1DaemonReply {
+	uint32_t magic; ///< SHA1DaemonMagic
+	int32_t status; ///< shaSuccess=0 表示成功, 其他非 0 值表示错误: shaBadParam / shaFileError
+	uint64_t id; ///< 对应请求的 ID
+	uint64_t length; ///< 实际参与计算的长度
+	uint8_t digest[SHA1HashSize]; ///< SHA1 摘要
+	uint8_t reserved[4]; ///< 保留, 置 0
+};
+
+/**
+ * @class SHA1Daemon
+ * @brief Unix 域套接字上的 SHA1 哈希服务
+ */
+class SHA1Daemon {
+private:
+	struct Connection;
+
+	/** 唤醒 run() 的 poll() 的管道: stop() 和完成请求的工作线程向其写入 */
+	struct WakePipe {
+		int fds[2];
+
+		WakePipe();
+		~WakePipe();
+	};
+
+	int listenFd;
+	WakePipe wake; ///< 必须声明在 pool 之前: 线程池先析构, 工作线程全部退出后才关闭管道
+	std::atomic<bool> stopping;
+	std::chrono::steady_clock::time_point acceptRetry; ///< 文件描述符耗尽时, 到此时刻之前不再 accept
+	std::string socketPath;
+	std::map<int, std::shared_ptr<Connection> > connections;
+	SHA1ThreadPool pool;
+
+	void acceptClient();
+	bool receive(const std::shared_ptr<Connection>& connection);
+
+public:
+	/** 构造函数 */
+	explicit SHA1Daemon(unsigned int threads = 0 ///< 哈希工作线程数, 0 表示按 SHA1ThreadPool::defaultThreads()
+			);
+
+	/** 析构函数: 关闭套接字并删除套接字文件 */
+	~SHA1Daemon();
+
+	SHA1Daemon(const SHA1Daemon&) = delete;
+	SHA1Daemon& operator=(const SHA1Daemon&) = delete;
+
+	/**
+	 * 在指定路径上创建监听套接字
+	 *
+	 * @details 路径上已有文件时, 只有确认是无人监听的遗留套接字才会删除;
+	 * 普通文件等其他类型(EEXIST)或仍有守护进程在监听的套接字(EADDRINUSE)会使本函数失败.
+	 * 所在目录不存在时以 0700 权限创建(只创建最后一级);
+	 * 目录属于其他用户, 或者其他用户可写而没有设置粘滞位时拒绝监听, 以免套接字被替换.
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaBadParam(路径过长) / shaFileError
+	 */
+	int listen(const char *path ///< 套接字路径
+			);
+
+	/**
+	 * 处理客户端请求, 直到 stop() 被调用
+	 *
+	 * @return shaSuccess=0 表示正常退出, 其他非 0 值表示错误: shaStateError(未调用 listen()) / shaFileError
+	 */
+	int run();
+
+	/**
+	 * 使 run() 返回
+	 *
+	 * @note 只设置原子标志并调用 write(), 可以在信号处理函数中调用
+	 */
+	void stop();
+
+	/**
+	 * 计算文件描述符指定区间的 SHA1 摘要(守护进程处理每个请求时调用)
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaBadParam(不是普通文件或 memfd) / shaFileError
+	 */
+	static int hashRegion(int fd, ///< 文件描述符
+			uint64_t offset, ///< 起始偏移
+			uint64_t length, ///< 长度, SHA1DaemonToEnd 表示到文件末尾
+			uint8_t digest[SHA1HashSize], ///< 输出摘要
+			uint64_t *hashedLength ///< 输出实际参与计算的长度
+			);
+};
+
+#endif//_SHA1_DAEMON_HPP_
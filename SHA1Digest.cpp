@@ -0,0 +1,45 @@
+#include "SHA1Digest.hpp"
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+int SHA1Digest::fromHex(const char *hex, SHA1Digest *digest) {
+	if (!hex || !digest) {
+		return shaNull;
+	}
+	for (int i = 0; i < SHA1HashSize; i++) {
+		int hi, lo;
+
+		hi = hexValue(hex[2 * i]);
+		if (hi < 0) {
+			return shaBadParam;
+		}
+		lo = hexValue(hex[2 * i + 1]);
+		if (lo < 0) {
+			return shaBadParam;
+		}
+		digest->bytes[i] = (uint8_t) ((hi << 4) | lo);
+	}
+	return shaSuccess;
+}
+
+std::string SHA1Digest::toHex() const {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex(2 * SHA1HashSize, '0');
+
+	for (int i = 0; i < SHA1HashSize; i++) {
+		hex[2 * i] = digits[bytes[i] >> 4];
+		hex[2 * i + 1] = digits[bytes[i] & 0x0F];
+	}
+	return hex;
+}
@@ -0,0 +1,105 @@
+/**
+* @file SHA1Digest.hpp
+* @brief SHA1 摘要值类型 C++ 语言头文件
+*
+* @details
+* SHA1Digest 是对 SHA1Result() 输出的 SHA1HashSize=20 字节摘要的值类型封装:
+* - 可平凡复制(trivially copyable), 大小恰好 20 字节, 可以直接整块写入文件或映射内存;
+* - 相等比较在常数时间内完成, 比较耗时与两个摘要在哪个字节开始不同无关;
+* - std::hash<SHA1Digest> 直接取摘要本身的比特作为哈希值(摘要已经是均匀分布的).
+*/
+
+#ifndef _SHA1_DIGEST_HPP_
+#define _SHA1_DIGEST_HPP_
+
+#ifndef __cplusplus
+#error "This header is only for C++"
+#endif
+
+#include "SHA1.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#if __cplusplus >= 201103L
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#endif // __cplusplus >= 201103L
+
+/**
+ * @struct SHA1Digest
+ * @brief 20 字节 SHA1 摘要
+ */
+struct SHA1Digest {
+	uint8_t bytes[SHA1HashSize]; ///< 摘要内容, 与 SHA1Result() 输出的字节顺序相同
+
+	/** 从 SHA1HashSize=20 字节的缓冲区构造摘要 */
+	static SHA1Digest fromBytes(const uint8_t digest[SHA1HashSize]) {
+		SHA1Digest d;
+
+		memcpy(d.bytes, digest, SHA1HashSize);
+		return d;
+	}
+
+	/**
+	 * 解析 40 个十六进制字符(大小写均可)
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaBadParam
+	 */
+	static int fromHex(const char *hex, ///< 40 个十六进制字符, 不要求以 '\0' 结尾
+			SHA1Digest *digest ///< 输出摘要
+			);
+
+	/** 转换为 40 个小写十六进制字符 */
+	std::string toHex() const;
+
+	/** 取摘要前 8 字节作为 64 位整数(本机字节序), 用作哈希表索引 */
+	uint64_t prefix64() const {
+		uint64_t x;
+
+		memcpy(&x, bytes, sizeof(x));
+		return x;
+	}
+
+	/** 常数时间相等比较 */
+	bool operator==(const SHA1Digest& other) const {
+		uint8_t diff = 0;
+
+		for (int i = 0; i < SHA1HashSize; i++) {
+			diff |= bytes[i] ^ other.bytes[i];
+		}
+		return diff == 0;
+	}
+
+	bool operator!=(const SHA1Digest& other) const {
+		return !(*this == other);
+	}
+
+	/**
+	 * 按字节序比较, 用于排序
+	 *
+	 * @note 排序比较不是常数时间的, 不要用它来判断两个摘要是否相等
+	 */
+	bool operator<(const SHA1Digest& other) const {
+		return memcmp(bytes, other.bytes, SHA1HashSize) < 0;
+	}
+};
+
+#if __cplusplus >= 201103L
+static_assert(sizeof(SHA1Digest) == SHA1HashSize, "SHA1Digest must be exactly SHA1HashSize bytes");
+static_assert(std::is_trivially_copyable<SHA1Digest>::value, "SHA1Digest must be trivially copyable");
+
+namespace std {
+/** std::hash<SHA1Digest>: 摘要本身已均匀分布, 直接取前 sizeof(size_t) 字节 */
+template<> struct hash<SHA1Digest> {
+	size_t operator()(const SHA1Digest& digest) const noexcept {
+		size_t x;
+
+		memcpy(&x, digest.bytes, sizeof(x));
+		return x;
+	}
+};
+} // namespace std
+#endif // __cplusplus >= 201103L
+
+#endif//_SHA1_DIGEST_HPP_
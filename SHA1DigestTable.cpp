@@ -0,0 +1,422 @@
+#include "SHA1DigestTable.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHA1_DIGEST_TABLE_SSE2 1
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** 控制字节: 空槽 */
+static const uint8_t kEmpty = 0x80;
+
+/**
+ * 磁盘格式文件头
+ *
+ * @note 文件头之后依次是分组数 * 16 字节的控制字节和分组数 * 16 个 20 字节摘要,
+ * 摘要数组从 64 字节对齐的偏移开始. 整数字段按本机字节序存储, 通过 endian 字段识别.
+ */
+struct SHA1DigestTableHeader {
+	char magic[8]; ///< "SHA1DTB"
+	uint32_t version; ///< 格式版本, 当前为 1
+	uint32_t endian; ///< 0x01020304
+	uint64_t groups; ///< 分组数
+	uint64_t count; ///< 元素个数
+	uint64_t controlOffset; ///< 控制字节起始偏移
+	uint64_t slotsOffset; ///< 摘要数组起始偏移
+};
+
+static const char kMagic[8] = { 'S', 'H', 'A', '1', 'D', 'T', 'B', '\0' };
+
+/*
+ * 由摘要计算分组索引和标签
+ *
+ * 摘要本身已均匀分布: 前 8 字节(按大尾端读取, 与平台无关)决定起始分组, 第 9 字节的低 7 位作为标签.
+ */
+static inline uint64_t groupHash(const SHA1Digest& digest) {
+	const uint8_t *b = digest.bytes;
+
+	return ((uint64_t) b[0] << 56) | ((uint64_t) b[1] << 48) | ((uint64_t) b[2] << 40) | ((uint64_t) b[3] << 32)
+			| ((uint64_t) b[4] << 24) | ((uint64_t) b[5] << 16) | ((uint64_t) b[6] << 8) | (uint64_t) b[7];
+}
+
+static inline uint8_t tagOf(const SHA1Digest& digest) {
+	return digest.bytes[8] & 0x7F;
+}
+
+/** 返回一组 16 个控制字节中等于 value 的位置掩码 */
+static inline uint32_t matchGroup(const uint8_t *group, uint8_t value) {
+#if defined(SHA1_DIGEST_TABLE_SSE2)
+	__m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) value)));
+#else
+	uint32_t mask = 0;
+
+	for (unsigned int i = 0; i < SHA1DigestTable::GroupSize; i++) {
+		mask |= (uint32_t) (group[i] == value) << i;
+	}
+	return mask;
+#endif
+}
+
+static inline unsigned int lowestBit(uint32_t mask) {
+#if defined(__GNUC__)
+	return (unsigned int) __builtin_ctz(mask);
+#else
+	unsigned int i = 0;
+
+	while (!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+static inline void prefetch(const void *p) {
+#if defined(__GNUC__)
+	__builtin_prefetch(p, 0, 1);
+#elif defined(SHA1_DIGEST_TABLE_SSE2)
+	_mm_prefetch((const char *) p, _MM_HINT_T1);
+#else
+	(void) p;
+#endif
+}
+
+// ===========================================================================
+// SHA1DigestTable
+// ===========================================================================
+
+SHA1DigestTable::SHA1DigestTable() :
+		control(NULL), slots(NULL), groupMask(0), count(0), mapping(NULL), mappingSize(0) {
+	clear();
+}
+
+SHA1DigestTable::SHA1DigestTable(uint64_t expected) :
+		control(NULL), slots(NULL), groupMask(0), count(0), mapping(NULL), mappingSize(0) {
+	clear();
+	(void) reserve(expected);
+}
+
+SHA1DigestTable::~SHA1DigestTable() {
+	unmap();
+}
+
+uint64_t SHA1DigestTable::size() const {
+	return count;
+}
+
+uint64_t SHA1DigestTable::capacity() const {
+	return (groupMask + 1) * GroupSize;
+}
+
+bool SHA1DigestTable::isMapped() const {
+	return mapping != NULL;
+}
+
+void SHA1DigestTable::clear() {
+	unmap();
+	ownedControl.assign(GroupSize, kEmpty);
+	ownedSlots.assign(GroupSize, SHA1Digest());
+	control = ownedControl.data();
+	slots = ownedSlots.data();
+	groupMask = 0;
+	count = 0;
+}
+
+int SHA1DigestTable::reserve(uint64_t expected) {
+	uint64_t groups;
+
+	if (isMapped()) {
+		return shaStateError;
+	}
+	/* 最大装载因子 7/8 */
+	groups = 1;
+	while (groups * GroupSize / 8 * 7 < expected) {
+		groups <<= 1;
+	}
+	if (groups > groupMask + 1) {
+		rehash(groups);
+	}
+	return shaSuccess;
+}
+
+void SHA1DigestTable::rehash(uint64_t groups) {
+	std::vector<uint8_t> oldControl;
+	std::vector<SHA1Digest> oldSlots;
+
+	oldControl.swap(ownedControl);
+	oldSlots.swap(ownedSlots);
+	ownedControl.assign(groups * GroupSize, kEmpty);
+	ownedSlots.resize(groups * GroupSize);
+	control = ownedControl.data();
+	slots = ownedSlots.data();
+	groupMask = groups - 1;
+	count = 0;
+	for (size_t i = 0; i < oldControl.size(); i++) {
+		if (oldControl[i] != kEmpty) {
+			(void) insertNoGrow(oldSlots[i]);
+		}
+	}
+}
+
+/*
+ * 分组间使用三角数探测序列 g, g+1, g+3, g+6, ...; 分组数为 2 的整数次幂时,
+ * 前 groupMask + 1 步恰好遍历所有分组各一次, 因此探测最多进行这么多步.
+ * 内存中的表装载因子不超过 7/8, 总能找到空槽; 映射的文件可能被篡改而没有空槽,
+ * 此时查询遍历完所有分组后返回未找到, 不会陷入死循环.
+ */
+bool SHA1DigestTable::insertNoGrow(const SHA1Digest& digest) {
+	uint64_t g = (groupHash(digest) >> 7) & groupMask;
+	uint8_t tag = tagOf(digest);
+
+	for (uint64_t step = 1; step <= groupMask + 1; step++) {
+		const uint8_t *group = control + g * GroupSize;
+		uint32_t mask;
+
+		for (mask = matchGroup(group, tag); mask; mask &= mask - 1) {
+			if (slots[g * GroupSize + lowestBit(mask)] == digest) {
+				return false;
+			}
+		}
+		mask = matchGroup(group, kEmpty);
+		if (mask) {
+			uint64_t i = g * GroupSize + lowestBit(mask);
+
+			ownedControl[i] = tag;
+			ownedSlots[i] = digest;
+			count++;
+			return true;
+		}
+		g = (g + step) & groupMask;
+	}
+	return false; // 不会发生: 装载因子不超过 7/8
+}
+
+int SHA1DigestTable::insert(const SHA1Digest& digest, bool *inserted) {
+	bool isNew;
+
+	if (isMapped()) {
+		return shaStateError;
+	}
+	if ((count + 1) > capacity() / 8 * 7) {
+		rehash((groupMask + 1) * 2);
+	}
+	isNew = insertNoGrow(digest);
+	if (inserted) {
+		*inserted = isNew;
+	}
+	return shaSuccess;
+}
+
+bool SHA1DigestTable::contains(const SHA1Digest& digest) const {
+	uint64_t g = (groupHash(digest) >> 7) & groupMask;
+	uint8_t tag = tagOf(digest);
+
+	for (uint64_t step = 1; step <= groupMask + 1; step++) {
+		const uint8_t *group = control + g * GroupSize;
+		uint32_t mask;
+
+		for (mask = matchGroup(group, tag); mask; mask &= mask - 1) {
+			if (slots[g * GroupSize + lowestBit(mask)] == digest) {
+				return true;
+			}
+		}
+		if (matchGroup(group, kEmpty)) {
+			return false;
+		}
+		g = (g + step) & groupMask;
+	}
+	return false;
+}
+
+/*
+ * 两级软件流水线:
+ * - 提前 2 * Distance 个元素预取其首个分组的控制字节;
+ * - 提前 Distance 个元素(此时控制字节应已在缓存中)比较标签, 预取第一个标签相同的槽位;
+ * - 对当前元素执行普通查询.
+ */
+void SHA1DigestTable::containsBatch(const SHA1Digest digests[], size_t n, bool found[]) const {
+	const size_t Distance = 8;
+
+	for (size_t i = 0; i < n; i++) {
+		if (i + 2 * Distance < n) {
+			uint64_t g = (groupHash(digests[i + 2 * Distance]) >> 7) & groupMask;
+
+			prefetch(control + g * GroupSize);
+		}
+		if (i + Distance < n) {
+			const SHA1Digest& next = digests[i + Distance];
+			uint64_t g = (groupHash(next) >> 7) & groupMask;
+			uint32_t mask = matchGroup(control + g * GroupSize, tagOf(next));
+
+			if (mask) {
+				prefetch(slots + g * GroupSize + lowestBit(mask));
+			}
+		}
+		found[i] = contains(digests[i]);
+	}
+}
+
+// ===========================================================================
+// 磁盘格式
+// ===========================================================================
+
+static uint64_t slotsOffsetFor(uint64_t groups) {
+	uint64_t offset;
+
+	offset = sizeof(SHA1DigestTableHeader) + groups * SHA1DigestTable::GroupSize;
+	return (offset + 63) & ~(uint64_t) 63;
+}
+
+int SHA1DigestTable::save(const char *path) const {
+	SHA1DigestTableHeader header;
+	FILE *fp;
+	uint64_t groups;
+	bool ok;
+
+	if (!path) {
+		return shaNull;
+	}
+	groups = groupMask + 1;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = 1;
+	header.endian = 0x01020304;
+	header.groups = groups;
+	header.count = count;
+	header.controlOffset = sizeof(header);
+	header.slotsOffset = slotsOffsetFor(groups);
+
+	fp = fopen(path, "wb");
+	if (!fp) {
+		return shaFileError;
+	}
+	ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fwrite(control, 1, groups * GroupSize, fp) == groups * GroupSize;
+	for (uint64_t pad = header.controlOffset + groups * GroupSize; ok && pad < header.slotsOffset; pad++) {
+		ok = fputc(0, fp) != EOF;
+	}
+	ok = ok && fwrite(slots, sizeof(SHA1Digest), groups * GroupSize, fp) == groups * GroupSize;
+	ok = (fclose(fp) == 0) && ok;
+	return ok ? shaSuccess : shaFileError;
+}
+
+/*
+ * 先按文件长度限制分组数, 之后的乘法和加法不会溢出;
+ * 元素个数不得超过装载上限 7/8(查询本身不依赖这一点, 见 insertNoGrow() 前的说明).
+ */
+static bool validHeader(const SHA1DigestTableHeader& header, uint64_t fileSize) {
+	uint64_t groups = header.groups;
+
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != 1 || header.endian != 0x01020304) {
+		return false;
+	}
+	if (groups == 0 || (groups & (groups - 1)) != 0
+			|| groups > fileSize / (SHA1DigestTable::GroupSize * (1 + sizeof(SHA1Digest)))
+			|| header.count > groups * SHA1DigestTable::GroupSize / 8 * 7) {
+		return false;
+	}
+	if (header.controlOffset != sizeof(header) || header.slotsOffset != slotsOffsetFor(groups)) {
+		return false;
+	}
+	return header.slotsOffset + groups * SHA1DigestTable::GroupSize * sizeof(SHA1Digest) <= fileSize;
+}
+
+int SHA1DigestTable::openMapped(const char *path) {
+	SHA1DigestTableHeader header;
+
+	if (!path) {
+		return shaNull;
+	}
+#if !defined(_WIN32)
+	int fd;
+	struct stat st;
+	void *p;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(header)) {
+		close(fd);
+		return shaFileError;
+	}
+	p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // 映射建立后即可关闭文件描述符
+	if (p == MAP_FAILED) {
+		return shaFileError;
+	}
+	memcpy(&header, p, sizeof(header));
+	if (!validHeader(header, (uint64_t) st.st_size)) {
+		munmap(p, (size_t) st.st_size);
+		return shaFileError;
+	}
+#if defined(MADV_RANDOM)
+	(void) madvise(p, (size_t) st.st_size, MADV_RANDOM); // 哈希查询是随机访问, 关闭预读
+#endif
+
+	clear();
+	std::vector<uint8_t>().swap(ownedControl);
+	std::vector<SHA1Digest>().swap(ownedSlots);
+	mapping = p;
+	mappingSize = (size_t) st.st_size;
+	control = (const uint8_t *) p + header.controlOffset;
+	slots = (const SHA1Digest *) ((const uint8_t *) p + header.slotsOffset);
+	groupMask = header.groups - 1;
+	count = header.count;
+	return shaSuccess;
+#else
+	/* 不支持 mmap 的平台: 读入内存 */
+	FILE *fp;
+	uint64_t groups;
+	long fileSize;
+	bool ok;
+
+	fp = fopen(path, "rb");
+	if (!fp) {
+		return shaFileError;
+	}
+	ok = fseek(fp, 0, SEEK_END) == 0 && (fileSize = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0;
+	ok = ok && fread(&header, sizeof(header), 1, fp) == 1;
+	groups = header.groups;
+	ok = ok && validHeader(header, (uint64_t) fileSize);
+	if (ok) {
+		clear();
+		ownedControl.resize(groups * GroupSize);
+		ownedSlots.resize(groups * GroupSize);
+		ok = fread(ownedControl.data(), 1, ownedControl.size(), fp) == ownedControl.size();
+		ok = ok && fseek(fp, (long) header.slotsOffset, SEEK_SET) == 0;
+		ok = ok && fread(ownedSlots.data(), sizeof(SHA1Digest), ownedSlots.size(), fp) == ownedSlots.size();
+		control = ownedControl.data();
+		slots = ownedSlots.data();
+		groupMask = groups - 1;
+		count = header.count;
+	}
+	fclose(fp);
+	if (!ok) {
+		clear();
+		return shaFileError;
+	}
+	return shaSuccess;
+#endif
+}
+
+void SHA1DigestTable::unmap() {
+#if !defined(_WIN32)
+	if (mapping) {
+		munmap(mapping, mappingSize);
+	}
+#endif
+	mapping = NULL;
+	mappingSize = 0;
+}
@@ -0,0 +1,129 @@
+/**
+* @file SHA1DigestTable.hpp
+* @brief SHA1 摘要集合(开放寻址哈希表) C++ 语言头文件
+*
+* @details
+* 用于在海量已知摘要中判断某个摘要是否存在(去重/成员查询).
+* 与 std::unordered_set<std::string> 相比, 每个元素只占 20 字节摘要 + 1 字节控制字节,
+* 没有逐元素的堆分配和指针跳转:
+* - 槽位按 16 个一组, 每组 16 个控制字节保存 7 比特标签(tag), 查找时一次比较一组标签
+*   (SSE2 可用时使用 SIMD 指令, 否则逐字节比较), 只有标签相同的槽位才比较完整摘要;
+* - containsBatch() 对一批摘要先预取所在分组再探测, 隐藏大表的缓存缺失延迟;
+* - save() 写出的磁盘格式与内存布局一致, openMapped() 可直接 mmap 只读打开, 无需重建.
+*
+* 表只支持插入和查询, 不支持删除.
+*
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+*/
+
+#ifndef _SHA1_DIGEST_TABLE_HPP_
+#define _SHA1_DIGEST_TABLE_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1Digest.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @class SHA1DigestTable
+ * @brief 开放寻址的 SHA1 摘要集合
+ */
+class SHA1DigestTable {
+public:
+	static const unsigned int GroupSize = 16; ///< 每组槽位数
+
+private:
+	std::vector<uint8_t> ownedControl;
+	std::vector<SHA1Digest> ownedSlots;
+	const uint8_t *control; ///< 控制字节: 0x80 表示空槽, 否则为 7 比特标签
+	const SHA1Digest *slots;
+	uint64_t groupMask; ///< 分组数 - 1 (分组数为 2 的整数次幂)
+	uint64_t count;
+	void *mapping; ///< 只读映射的文件内容, 非映射时为 NULL
+	size_t mappingSize;
+
+	void rehash(uint64_t groups);
+	bool insertNoGrow(const SHA1Digest& digest);
+	void unmap();
+
+public:
+	/** 构造一个空表 */
+	SHA1DigestTable();
+
+	/** 构造一个空表并预留容纳 expected 个摘要的空间 */
+	explicit SHA1DigestTable(uint64_t expected ///< 预计元素个数
+			);
+
+	/** 析构函数 */
+	~SHA1DigestTable();
+
+	SHA1DigestTable(const SHA1DigestTable&) = delete;
+	SHA1DigestTable& operator=(const SHA1DigestTable&) = delete;
+
+	/**
+	 * 插入一个摘要
+	 *
+	 * @return shaSuccess=0 表示成功(包括摘要已存在的情况), 其他非 0 值表示错误: shaStateError(表为只读映射)
+	 */
+	int insert(const SHA1Digest& digest, ///< 摘要
+			bool *inserted = NULL ///< 可选输出: true 表示新插入, false 表示已存在
+			);
+
+	/** 查询摘要是否存在 */
+	bool contains(const SHA1Digest& digest ///< 摘要
+			) const;
+
+	/**
+	 * 批量查询, 结果与逐个调用 contains() 相同
+	 *
+	 * @details 对后续若干个摘要所在的分组预先发出预取指令, 使多次缓存缺失并行进行
+	 */
+	void containsBatch(const SHA1Digest digests[], ///< 待查询摘要数组
+			size_t n, ///< 摘要个数
+			bool found[] ///< 输出: found[i] 表示 digests[i] 是否存在
+			) const;
+
+	/**
+	 * 预留空间, 使之后插入 expected 个摘要时不再扩容
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaStateError(表为只读映射)
+	 */
+	int reserve(uint64_t expected ///< 预计元素个数
+			);
+
+	/** 查询元素个数 */
+	uint64_t size() const;
+
+	/** 查询槽位总数 */
+	uint64_t capacity() const;
+
+	/** 是否为只读映射的表 */
+	bool isMapped() const;
+
+	/** 清空表(若为映射的表则解除映射) */
+	void clear();
+
+	/**
+	 * 保存为磁盘格式
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 */
+	int save(const char *path ///< 文件名
+			) const;
+
+	/**
+	 * 以只读方式映射 save() 生成的文件, 替换当前内容
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 * @note 映射后的表不能再插入; 不支持 mmap 的平台上会把文件读入内存
+	 */
+	int openMapped(const char *path ///< 文件名
+			);
+};
+
+#endif//_SHA1_DIGEST_TABLE_HPP_
@@ -0,0 +1,77 @@
+#include "SHA1FileInput.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/** 每个线程复用一个读缓冲区, 避免每个文件都重新分配 */
+static uint8_t *readBuffer() {
+	static thread_local std::vector<uint8_t> buffer(SHA1ReadBufferSize);
+
+	return buffer.data();
+}
+
+void SHA1InputBuffer(SHA1& hasher, const uint8_t data[], uint64_t length) {
+	const uint64_t step = 1U << 30;
+
+	while (length > step) {
+		hasher.inputData(data, (unsigned int) step);
+		data += step;
+		length -= step;
+	}
+	hasher.inputData(data, (unsigned int) length);
+}
+
+int SHA1InputStream(SHA1& hasher, FILE *fp, uint64_t *hashedLength) {
+	uint8_t *buffer = readBuffer();
+	uint64_t total = 0;
+	size_t n;
+
+	while ((n = fread(buffer, 1, SHA1ReadBufferSize, fp)) > 0) {
+		hasher.inputData(buffer, (unsigned int) n);
+		total += n;
+	}
+	if (hashedLength) {
+		*hashedLength = total;
+	}
+	return ferror(fp) ? shaFileError : shaSuccess;
+}
+
+#if !defined(_WIN32)
+int SHA1InputFd(SHA1& hasher, int fd, uint64_t offset, uint64_t length, bool stream, uint64_t *hashedLength) {
+	uint8_t *buffer = readBuffer();
+	uint64_t done = 0;
+	int err = shaSuccess;
+
+	while (done < length) {
+		size_t want = (size_t) std::min<uint64_t>(length - done, SHA1ReadBufferSize);
+		ssize_t n;
+
+		if (stream) {
+			n = read(fd, buffer, want);
+		} else {
+			n = pread(fd, buffer, want, (off_t) (offset + done));
+		}
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			err = shaFileError;
+			break;
+		}
+		if (n == 0) {
+			break; // 文件末尾
+		}
+		hasher.inputData(buffer, (unsigned int) n);
+		done += (uint64_t) n;
+	}
+	if (hashedLength) {
+		*hashedLength = done;
+	}
+	return err;
+}
+#endif
@@ -0,0 +1,70 @@
+/**
+* @file SHA1FileInput.hpp
+* @brief 向 SHA1 计算器输入大块内存和文件内容的公共函数 C++ 语言头文件
+*
+* @details
+* 清单、git 对象、异步执行器和守护进程等模块都需要把超过 unsigned int 范围的缓冲区
+* 或整个文件的内容输入 SHA1 计算器, 统一使用这里的函数, 读缓冲区长度也在此统一定义.
+*
+* @note SHA1InputFd() 使用 POSIX pread()/read() 接口, 在 _WIN32 平台上不提供
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+*/
+
+#ifndef _SHA1_FILE_INPUT_HPP_
+#define _SHA1_FILE_INPUT_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** 读取文件时每次读入的长度 */
+static const size_t SHA1ReadBufferSize = 256 * 1024;
+
+/**
+ * 输入任意长度的内存数据
+ *
+ * @details SHA1::inputData() 的长度参数为 unsigned int, 超长缓冲区分段输入
+ */
+void SHA1InputBuffer(SHA1& hasher, ///< SHA1 计算器
+		const uint8_t data[], ///< 输入数据
+		uint64_t length ///< 输入数据长度
+		);
+
+/**
+ * 读取标准 I/O 流直到文件末尾并输入
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaFileError
+ */
+int SHA1InputStream(SHA1& hasher, ///< SHA1 计算器
+		FILE *fp, ///< 已打开的文件
+		uint64_t *hashedLength ///< 可选输出: 输入的字节数
+		);
+
+#if !defined(_WIN32)
+/**
+ * 读取文件描述符的一段内容并输入
+ *
+ * @details 读到 length 字节或文件末尾为止, *hashedLength 小于 length 表示遇到了文件末尾.
+ * stream 为 false 时使用 pread() 从 offset 开始读取, 不改变描述符的当前偏移;
+ * stream 为 true 时(管道、套接字等)忽略 offset, 用 read() 从当前位置顺序读取.
+ * 被信号中断的读取会自动重试.
+ *
+ * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaFileError(errno 保留读取失败的原因,
+ * 例如非阻塞描述符暂无数据时为 EAGAIN; 出错前已输入的字节数同样计入 *hashedLength)
+ */
+int SHA1InputFd(SHA1& hasher, ///< SHA1 计算器
+		int fd, ///< 文件描述符
+		uint64_t offset, ///< 起始偏移
+		uint64_t length, ///< 最多读取的长度
+		bool stream, ///< 是否为不可定位的描述符
+		uint64_t *hashedLength ///< 可选输出: 输入的字节数
+		);
+#endif
+
+#endif//_SHA1_FILE_INPUT_HPP_
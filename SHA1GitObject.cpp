@@ -0,0 +1,318 @@
+#include "SHA1GitObject.hpp"
+#include "SHA1.hpp"
+#include "SHA1FileInput.hpp"
+#include "SHA1ThreadPool.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * 输入对象头部 "<类型> <长度>\0"
+ *
+ * 头部总是短于一个 64 字节分组, 由 SHA1 的分组缓冲区与随后的内容拼接,
+ * 因此不需要单独保存头部的中间状态, 内容数据也只需读取一遍.
+ */
+static void inputHeader(SHA1& hasher, const char *type, uint64_t length) {
+	char header[64];
+	int n;
+
+	n = snprintf(header, sizeof(header), "%s %llu", type, (unsigned long long) length);
+	hasher.inputData((const uint8_t *) header, (unsigned int) n + 1); // 包括结尾的 '\0'
+}
+
+int SHA1GitObject::objectId(const char *type, const uint8_t data[], size_t length, SHA1Digest *id) {
+	SHA1 hasher;
+
+	if (!type || !id || (!data && length)) {
+		return shaNull;
+	}
+	inputHeader(hasher, type, length);
+	SHA1InputBuffer(hasher, data, length);
+	hasher.inputEnd();
+	hasher.getHashResult(*id);
+	return shaSuccess;
+}
+
+int SHA1GitObject::blobId(const uint8_t data[], size_t length, SHA1Digest *id) {
+	return objectId("blob", data, length, id);
+}
+
+/*
+ * 计算符号链接本身的 blob ID, 内容为链接目标字符串(tree 中模式为 120000 的条目)
+ *
+ * 只用于目录遍历; 公开的 blobIdForFile() 与 git hash-object 一样跟随链接.
+ */
+static int symlinkBlobId(const char *path, SHA1Digest *id) {
+	struct stat st;
+	std::vector<char> target;
+	ssize_t n;
+
+	if (lstat(path, &st) != 0 || !S_ISLNK(st.st_mode)) {
+		return shaFileError;
+	}
+	target.resize((size_t) st.st_size + 1);
+	n = readlink(path, target.data(), target.size());
+	if (n < 0 || (size_t) n >= target.size()) {
+		return shaFileError;
+	}
+	return SHA1GitObject::blobId((const uint8_t *) target.data(), (size_t) n, id);
+}
+
+int SHA1GitObject::blobIdForFile(const char *path, SHA1Digest *id) {
+	SHA1 hasher;
+	struct stat st;
+	uint64_t size, hashed;
+	uint8_t extra;
+	int fd;
+	int err;
+
+	if (!path || !id) {
+		return shaNull;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return shaFileError;
+	}
+	size = (uint64_t) st.st_size;
+	inputHeader(hasher, "blob", size);
+	err = SHA1InputFd(hasher, fd, 0, size, false, &hashed);
+	if (!err && (hashed != size || pread(fd, &extra, 1, (off_t) size) != 0)) {
+		err = shaFileError; // 读取过程中文件长度发生了变化, 头部中的长度已经不对
+	}
+	close(fd);
+	if (err) {
+		return err;
+	}
+	hasher.inputEnd();
+	hasher.getHashResult(*id);
+	return shaSuccess;
+}
+
+/* git 的 tree 条目排序规则: 按名称字节序比较, 目录名视为以 '/' 结尾 */
+static bool entryLess(const SHA1GitTreeEntry& a, const SHA1GitTreeEntry& b) {
+	size_t n = std::min(a.name.size(), b.name.size());
+	int c;
+	unsigned char ca, cb;
+
+	c = memcmp(a.name.data(), b.name.data(), n);
+	if (c != 0) {
+		return c < 0;
+	}
+	ca = (n < a.name.size()) ? (unsigned char) a.name[n] : (a.mode == SHA1GitModeTree) ? '/' : '\0';
+	cb = (n < b.name.size()) ? (unsigned char) b.name[n] : (b.mode == SHA1GitModeTree) ? '/' : '\0';
+	return ca < cb;
+}
+
+int SHA1GitObject::treeId(std::vector<SHA1GitTreeEntry> entries, SHA1Digest *id) {
+	std::string content;
+
+	if (!id) {
+		return shaNull;
+	}
+	std::sort(entries.begin(), entries.end(), entryLess);
+	for (size_t i = 0; i < entries.size(); i++) {
+		char mode[16];
+
+		if (entries[i].name.empty() || entries[i].name.find('/') != std::string::npos
+				|| (i > 0 && entries[i].name == entries[i - 1].name)) {
+			return shaBadParam;
+		}
+		/* "<八进制模式> <名称>\0<20 字节对象 ID>", 模式不补前导 0 */
+		snprintf(mode, sizeof(mode), "%o ", (unsigned int) entries[i].mode);
+		content += mode;
+		content += entries[i].name;
+		content += '\0';
+		content.append((const char *) entries[i].id.bytes, SHA1HashSize);
+	}
+	return objectId("tree", (const uint8_t *) content.data(), content.size(), id);
+}
+
+// ===========================================================================
+// 目录的并行遍历与哈希
+// ===========================================================================
+
+namespace {
+
+/**
+ * 目录树中的一个节点
+ *
+ * @note 每个节点只由一个任务写入: 目录节点的 children 由扫描该目录的任务填充, 文件节点的 id 由哈希该文件的任务填充
+ */
+struct Node {
+	std::string name;
+	std::string path;
+	uint32_t mode;
+	SHA1Digest id;
+	std::vector<std::unique_ptr<Node> > children;
+};
+
+/**
+ * 一次目录计算中所有任务共享的状态
+ */
+class TreeWalk {
+private:
+	SHA1ThreadPool pool;
+	std::mutex mutex;
+	std::condition_variable idle;
+	size_t pending;
+	int firstError;
+
+	void submit(Node *node);
+	void scanDirectory(Node *node);
+	void hashFile(Node *node);
+	void finishTask(int err);
+
+public:
+	explicit TreeWalk(unsigned int threads) :
+			pool(threads), pending(0), firstError(shaSuccess) {
+	}
+
+	/** 扫描并哈希 root 下的全部文件, 返回第一个错误 */
+	int run(Node *root) {
+		submit(root);
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return pending == 0; });
+		return firstError;
+	}
+};
+
+void TreeWalk::submit(Node *node) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending++;
+	}
+	if (node->mode == SHA1GitModeTree) {
+		pool.post([this, node]() { scanDirectory(node); });
+	} else {
+		pool.post([this, node]() { hashFile(node); });
+	}
+}
+
+void TreeWalk::finishTask(int err) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (err && !firstError) {
+		firstError = err;
+	}
+	if (--pending == 0) {
+		idle.notify_all();
+	}
+}
+
+void TreeWalk::hashFile(Node *node) {
+	if (node->mode == SHA1GitModeSymlink) {
+		finishTask(symlinkBlobId(node->path.c_str(), &node->id));
+	} else {
+		finishTask(SHA1GitObject::blobIdForFile(node->path.c_str(), &node->id));
+	}
+}
+
+void TreeWalk::scanDirectory(Node *node) {
+	DIR *dir;
+	struct dirent *ent;
+
+	dir = opendir(node->path.c_str());
+	if (!dir) {
+		finishTask(shaFileError);
+		return;
+	}
+	while ((ent = readdir(dir)) != NULL) {
+		std::unique_ptr<Node> child(new Node);
+		struct stat st;
+
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0 || strcmp(ent->d_name, ".git") == 0) {
+			continue;
+		}
+		child->name = ent->d_name;
+		child->path = node->path + "/" + child->name;
+		if (lstat(child->path.c_str(), &st) != 0) {
+			closedir(dir);
+			finishTask(shaFileError);
+			return;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			child->mode = SHA1GitModeTree;
+		} else if (S_ISLNK(st.st_mode)) {
+			child->mode = SHA1GitModeSymlink;
+		} else if (S_ISREG(st.st_mode)) {
+			child->mode = (st.st_mode & S_IXUSR) ? SHA1GitModeExecutable : SHA1GitModeFile;
+		} else {
+			continue; // 设备文件、FIFO、套接字等不能加入 git 索引
+		}
+		node->children.push_back(std::move(child));
+	}
+	closedir(dir);
+	for (size_t i = 0; i < node->children.size(); i++) {
+		submit(node->children[i].get());
+	}
+	finishTask(shaSuccess);
+}
+
+/*
+ * 自底向上生成 tree 对象
+ *
+ * 返回 false 表示该目录下没有任何文件, 与 git 一样不写入上级 tree.
+ */
+static bool buildTree(Node *node, int *err) {
+	std::vector<SHA1GitTreeEntry> entries;
+
+	entries.reserve(node->children.size());
+	for (size_t i = 0; i < node->children.size(); i++) {
+		Node *child = node->children[i].get();
+		SHA1GitTreeEntry entry;
+
+		if (child->mode == SHA1GitModeTree && !buildTree(child, err)) {
+			continue;
+		}
+		entry.name = child->name;
+		entry.mode = child->mode;
+		entry.id = child->id;
+		entries.push_back(entry);
+	}
+	node->children.clear();
+	if (!*err) {
+		*err = SHA1GitObject::treeId(entries, &node->id);
+	}
+	return !entries.empty();
+}
+
+} // namespace
+
+int SHA1GitObject::treeIdForDirectory(const char *directory, SHA1Digest *id, unsigned int threads) {
+	Node root;
+	int err;
+
+	if (!directory || !id) {
+		return shaNull;
+	}
+	root.path = directory;
+	root.mode = SHA1GitModeTree;
+	{
+		TreeWalk walk(threads);
+
+		err = walk.run(&root);
+	}
+	if (err) {
+		return err;
+	}
+	(void) buildTree(&root, &err);
+	if (err) {
+		return err;
+	}
+	*id = root.id;
+	return shaSuccess;
+}
@@ -0,0 +1,116 @@
+/**
+* @file SHA1GitObject.hpp
+* @brief 计算 git 对象 ID(blob / tree) 的 C++ 语言头文件
+*
+* @details
+* git 对象 ID 是 "<类型> <内容长度>\0" 头部加上对象内容的 SHA1 摘要. 本模块在 git 之外计算:
+* - 缓冲区和文件的 blob ID, 结果与 `git hash-object` 相同;
+* - 目录的 tree ID, 结果与把该目录全部文件加入空索引后执行 `git write-tree` 相同.
+*
+* 计算目录时, 子目录的扫描和文件的哈希都作为任务提交给 SHA1ThreadPool 并行执行,
+* 全部完成后再自底向上生成各级 tree 对象.
+*
+* 与 git 的约定一致:
+* - 普通文件模式为 100644, 用户可执行文件为 100755, 符号链接为 120000(内容为链接目标), 目录为 40000;
+* - 名为 .git 的目录项被忽略; 空目录(以及只含空目录的目录)不会出现在 tree 中;
+* - tree 中的条目按名称字节序排序, 比较时目录名视为以 '/' 结尾.
+*
+* @note 子模块(gitlink, 模式 160000)需要读取子仓库的提交 ID, 不在本模块支持范围内, 嵌套仓库按普通目录处理.
+* @note 不读取 .gitignore / .git/info/exclude, 被忽略的文件同样计入 tree, 相当于 git add -A --force.
+* @note 目录遍历使用 POSIX opendir()/lstat()/readlink() 接口
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+* @example example_git.cpp 是一个计算 git 对象 ID 的 C++ 示例程序
+*/
+
+#ifndef _SHA1_GIT_OBJECT_HPP_
+#define _SHA1_GIT_OBJECT_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1Digest.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** git tree 条目的文件模式 */
+enum SHA1GitMode {
+	SHA1GitModeTree = 040000, ///< 目录
+	SHA1GitModeFile = 0100644, ///< 普通文件
+	SHA1GitModeExecutable = 0100755, ///< 可执行文件
+	SHA1GitModeSymlink = 0120000, ///< 符号链接
+	SHA1GitModeGitlink = 0160000, ///< 子模块
+};
+
+/**
+ * tree 对象中的一个条目
+ */
+struct SHA1GitTreeEntry {
+	std::string name; ///< 条目名称(不含路径分隔符)
+	uint32_t mode; ///< 文件模式, 见 SHA1GitMode
+	SHA1Digest id; ///< 条目对应对象的 ID
+};
+
+/**
+ * @class SHA1GitObject
+ * @brief git 对象 ID 计算
+ */
+class SHA1GitObject {
+public:
+	/**
+	 * 计算任意类型对象的 ID
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull
+	 */
+	static int objectId(const char *type, ///< 对象类型, 如 "blob" / "tree" / "commit"
+			const uint8_t data[], ///< 对象内容
+			size_t length, ///< 对象内容长度
+			SHA1Digest *id ///< 输出对象 ID
+			);
+
+	/**
+	 * 计算缓冲区内容的 blob ID (等同于 git hash-object --stdin)
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull
+	 */
+	static int blobId(const uint8_t data[], ///< 文件内容
+			size_t length, ///< 文件内容长度
+			SHA1Digest *id ///< 输出 blob ID
+			);
+
+	/**
+	 * 计算文件的 blob ID (等同于 git hash-object --no-filters)
+	 *
+	 * @details 文件长度由 fstat() 预先得到, 头部和内容在一遍读取中完成哈希;
+	 * 与 git hash-object 相同, 符号链接会被跟随, 计算的是链接指向的文件
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 */
+	static int blobIdForFile(const char *path, ///< 文件名
+			SHA1Digest *id ///< 输出 blob ID
+			);
+
+	/**
+	 * 由条目列表计算 tree ID
+	 *
+	 * @details 条目会按 git 的规则排序后再编码, 调用者无需预先排序
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaBadParam(条目名称为空或含有 '/' 或重复)
+	 */
+	static int treeId(std::vector<SHA1GitTreeEntry> entries, ///< 条目列表
+			SHA1Digest *id ///< 输出 tree ID
+			);
+
+	/**
+	 * 递归计算目录的 tree ID (等同于把目录下全部文件加入空索引后执行 git write-tree)
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 */
+	static int treeIdForDirectory(const char *directory, ///< 目录名
+			SHA1Digest *id, ///< 输出 tree ID
+			unsigned int threads = 0 ///< 工作线程数, 0 表示按 SHA1ThreadPool::defaultThreads()
+			);
+};
+
+#endif//_SHA1_GIT_OBJECT_HPP_
@@ -0,0 +1,518 @@
+#include "SHA1Manifest.hpp"
+#include "SHA1.hpp"
+#include "SHA1FileInput.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * 清单文件头
+ */
+struct SHA1ManifestHeader {
+	char magic[8]; ///< "SHA1MAN"
+	uint32_t version; ///< 格式版本, 当前为 1
+	uint32_t endian; ///< 0x01020304
+	uint64_t count; ///< 记录条数
+	uint64_t pathOffsetsOffset; ///< 路径偏移表起始偏移
+	uint64_t sizesOffset; ///< 文件长度数组起始偏移
+	uint64_t digestsOffset; ///< 摘要数组起始偏移
+	uint64_t pathsOffset; ///< 路径字符串区起始偏移
+	uint64_t pathsSize; ///< 路径字符串区长度
+};
+
+static const char kMagic[8] = { 'S', 'H', 'A', '1', 'M', 'A', 'N', '\0' };
+
+// ===========================================================================
+// SHA1Manifest
+// ===========================================================================
+
+SHA1Manifest::SHA1Manifest() :
+		base(NULL), mappingSize(0), count(0), pathOffsets(NULL), sizes(NULL), digests(NULL), paths(NULL), pathsSize(0) {
+}
+
+SHA1Manifest::~SHA1Manifest() {
+	close();
+}
+
+int SHA1Manifest::hashFile(const char *path, SHA1Digest *digest, uint64_t *size) {
+	SHA1 hasher;
+	uint64_t total;
+	FILE *fp;
+	int err;
+
+	if (!path || !digest) {
+		return shaNull;
+	}
+	fp = fopen(path, "rb");
+	if (!fp) {
+		return shaFileError;
+	}
+	err = SHA1InputStream(hasher, fp, &total);
+	fclose(fp);
+	if (err) {
+		return err;
+	}
+	hasher.inputEnd();
+	hasher.getHashResult(*digest);
+	if (size) {
+		*size = total;
+	}
+	return shaSuccess;
+}
+
+int SHA1Manifest::open(const char *path) {
+	SHA1ManifestHeader header;
+
+	if (!path) {
+		return shaNull;
+	}
+	close();
+#if !defined(_WIN32)
+	int fd;
+	struct stat st;
+	void *p;
+
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return shaFileError;
+	}
+	if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(header)) {
+		::close(fd);
+		return shaFileError;
+	}
+	p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED) {
+		return shaFileError;
+	}
+	base = (const uint8_t *) p;
+	mappingSize = (size_t) st.st_size;
+#else
+	/* 不支持 mmap 的平台: 读入内存 */
+	FILE *fp;
+	long length;
+	uint8_t *buffer;
+
+	fp = fopen(path, "rb");
+	if (!fp) {
+		return shaFileError;
+	}
+	buffer = NULL;
+	if (fseek(fp, 0, SEEK_END) == 0 && (length = ftell(fp)) >= (long) sizeof(header) && fseek(fp, 0, SEEK_SET) == 0) {
+		buffer = new uint8_t[length];
+		if (fread(buffer, 1, (size_t) length, fp) != (size_t) length) {
+			delete[] buffer;
+			buffer = NULL;
+		}
+	}
+	fclose(fp);
+	if (!buffer) {
+		return shaFileError;
+	}
+	base = buffer;
+	mappingSize = (size_t) length;
+#endif
+
+	/*
+	 * 校验文件头和各区段范围; 路径偏移表可能很大, 不在此逐项检查, 由 pathAt() 在访问时检查.
+	 * 先按文件长度限制记录条数, 再计算各区段偏移, 保证下面的算术不会溢出.
+	 */
+	memcpy(&header, base, sizeof(header));
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != 1 || header.endian != 0x01020304
+			|| header.count > mappingSize / (sizeof(uint64_t) + sizeof(uint64_t) + sizeof(SHA1Digest))
+			|| header.pathOffsetsOffset != sizeof(header)
+			|| header.sizesOffset != header.pathOffsetsOffset + (header.count + 1) * sizeof(uint64_t)
+			|| header.digestsOffset != header.sizesOffset + header.count * sizeof(uint64_t)
+			|| header.pathsOffset != header.digestsOffset + header.count * sizeof(SHA1Digest)
+			|| header.pathsOffset > mappingSize || header.pathsSize > mappingSize - header.pathsOffset) {
+		close();
+		return shaFileError;
+	}
+	count = header.count;
+	pathOffsets = (const uint64_t *) (base + header.pathOffsetsOffset);
+	sizes = (const uint64_t *) (base + header.sizesOffset);
+	digests = (const SHA1Digest *) (base + header.digestsOffset);
+	paths = (const char *) (base + header.pathsOffset);
+	pathsSize = header.pathsSize;
+	return shaSuccess;
+}
+
+void SHA1Manifest::close() {
+	if (base) {
+#if !defined(_WIN32)
+		munmap((void *) base, mappingSize);
+#else
+		delete[] base;
+#endif
+	}
+	base = NULL;
+	mappingSize = 0;
+	count = 0;
+	pathOffsets = NULL;
+	sizes = NULL;
+	digests = NULL;
+	paths = NULL;
+	pathsSize = 0;
+}
+
+size_t SHA1Manifest::size() const {
+	return (size_t) count;
+}
+
+/* 取第 index 条记录的路径, 路径偏移越界或逆序(清单损坏)时返回 false */
+bool SHA1Manifest::pathAt(uint64_t index, const char **path, size_t *length) const {
+	uint64_t begin = pathOffsets[index];
+	uint64_t end = pathOffsets[index + 1];
+
+	if (begin > end || end > pathsSize) {
+		return false;
+	}
+	*path = paths + begin;
+	*length = (size_t) (end - begin);
+	return true;
+}
+
+std::string SHA1Manifest::path(size_t index) const {
+	const char *p;
+	size_t length;
+
+	if (!pathAt(index, &p, &length)) {
+		return std::string();
+	}
+	return std::string(p, length);
+}
+
+uint64_t SHA1Manifest::fileSize(size_t index) const {
+	return sizes[index];
+}
+
+const SHA1Digest& SHA1Manifest::digest(size_t index) const {
+	return digests[index];
+}
+
+/* 与 std::string::compare() 相同的字节序比较, 但直接比较映射区中的字符串 */
+static int comparePath(const char *a, size_t aLength, const std::string& b) {
+	int c;
+
+	c = memcmp(a, b.data(), std::min(aLength, b.size()));
+	if (c != 0) {
+		return c;
+	}
+	return (aLength < b.size()) ? -1 : (aLength > b.size()) ? 1 : 0;
+}
+
+bool SHA1Manifest::find(const std::string& path, size_t *index) const {
+	uint64_t lo = 0, hi = count;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		const char *p;
+		size_t length;
+		int c;
+
+		if (!pathAt(mid, &p, &length)) {
+			return false;
+		}
+		c = comparePath(p, length, path);
+		if (c == 0) {
+			if (index) {
+				*index = (size_t) mid;
+			}
+			return true;
+		}
+		if (c < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return false;
+}
+
+size_t SHA1Manifest::verify(unsigned int threads, VerifyCallback callback) const {
+	std::atomic<uint64_t> next(0);
+	std::atomic<size_t> failures(0);
+	std::vector<std::future<void> > done;
+
+	if (threads == 0) {
+		threads = SHA1ThreadPool::defaultThreads();
+	}
+	SHA1ThreadPool pool(threads);
+
+	/* 每个工作线程各自从共享计数器领取下一条记录, 无需为每条记录分配任务 */
+	for (unsigned int t = 0; t < threads; t++) {
+		std::shared_ptr<std::packaged_task<void()> > task;
+
+		task = std::make_shared<std::packaged_task<void()> >([this, &next, &failures, &callback]() {
+			uint64_t i;
+
+			while ((i = next++) < count) {
+				SHA1ManifestStatus status = SHA1ManifestOK;
+				std::string name = path((size_t) i);
+				struct stat st;
+				SHA1Digest actual;
+
+				if (stat(name.c_str(), &st) != 0) {
+					status = SHA1ManifestMissing;
+				} else if (sizes[i] != SHA1ManifestUnknownSize && (uint64_t) st.st_size != sizes[i]) {
+					status = SHA1ManifestSizeMismatch;
+				} else if (hashFile(name.c_str(), &actual, NULL) != shaSuccess) {
+					status = SHA1ManifestMissing;
+				} else if (actual != digests[i]) {
+					status = SHA1ManifestDigestMismatch;
+				}
+				if (status != SHA1ManifestOK) {
+					failures++;
+				}
+				if (callback) {
+					callback((size_t) i, status);
+				}
+			}
+		});
+		done.push_back(task->get_future());
+		pool.post([task]() { (*task)(); });
+	}
+	for (size_t t = 0; t < done.size(); t++) {
+		done[t].get();
+	}
+	return failures;
+}
+
+/*
+ * sha1sum 对含有 '\\'、换行符或回车符的文件名进行转义("\\\\"、"\\n"、"\\r"), 并在该行行首加一个 '\\'
+ */
+int SHA1Manifest::toSha1sum(const char *textPath) const {
+	FILE *fp;
+	bool ok = true;
+
+	if (!textPath) {
+		return shaNull;
+	}
+	fp = fopen(textPath, "wb");
+	if (!fp) {
+		return shaFileError;
+	}
+	for (uint64_t i = 0; ok && i < count; i++) {
+		const char *p;
+		size_t length;
+		std::string line;
+
+		ok = pathAt(i, &p, &length);
+		if (!ok) {
+			break; // 清单损坏
+		}
+		std::string name(p, length);
+
+		if (name.find_first_of("\\\n\r") != std::string::npos) {
+			line += '\\';
+		}
+		line += digests[i].toHex();
+		line += "  ";
+		for (size_t k = 0; k < name.size(); k++) {
+			if (name[k] == '\\') {
+				line += "\\\\";
+			} else if (name[k] == '\n') {
+				line += "\\n";
+			} else if (name[k] == '\r') {
+				line += "\\r";
+			} else {
+				line += name[k];
+			}
+		}
+		line += '\n';
+		ok = fwrite(line.data(), 1, line.size(), fp) == line.size();
+	}
+	ok = (fclose(fp) == 0) && ok;
+	return ok ? shaSuccess : shaFileError;
+}
+
+int SHA1Manifest::fromSha1sum(const char *textPath, const char *manifestPath) {
+	SHA1ManifestWriter writer(1);
+	std::string line;
+
+	if (!textPath || !manifestPath) {
+		return shaNull;
+	}
+	std::ifstream in(textPath, std::ios::in | std::ios::binary);
+	if (!in) {
+		return shaFileError;
+	}
+	while (std::getline(in, line)) {
+		SHA1Digest digest;
+		std::string name;
+		struct stat st;
+		size_t p = 0;
+		bool escaped = false;
+
+		if (line.empty()) {
+			continue;
+		}
+		if (line[0] == '\\') {
+			escaped = true;
+			p = 1;
+		}
+		/* "<摘要><空格><空格或'*'><文件名>" */
+		if (line.size() < p + 2 * SHA1HashSize + 3 || line[p + 2 * SHA1HashSize] != ' '
+				|| (line[p + 2 * SHA1HashSize + 1] != ' ' && line[p + 2 * SHA1HashSize + 1] != '*')
+				|| SHA1Digest::fromHex(line.data() + p, &digest) != shaSuccess) {
+			return shaBadParam;
+		}
+		for (size_t k = p + 2 * SHA1HashSize + 2; k < line.size(); k++) {
+			if (escaped && line[k] == '\\') {
+				if (++k == line.size()) {
+					return shaBadParam;
+				}
+				switch (line[k]) {
+				case '\\':
+					name += '\\';
+					break;
+				case 'n':
+					name += '\n';
+					break;
+				case 'r':
+					name += '\r';
+					break;
+				default:
+					return shaBadParam; // sha1sum 不会产生其他转义
+				}
+			} else {
+				name += line[k];
+			}
+		}
+		writer.addEntry(name, digest, (stat(name.c_str(), &st) == 0) ? (uint64_t) st.st_size : SHA1ManifestUnknownSize);
+	}
+	return writer.finish(manifestPath);
+}
+
+// ===========================================================================
+// SHA1ManifestWriter
+// ===========================================================================
+
+SHA1ManifestWriter::SHA1ManifestWriter(unsigned int threads) :
+		pending(0), firstError(shaSuccess), pool(threads) {
+}
+
+SHA1ManifestWriter::~SHA1ManifestWriter() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return pending == 0; });
+}
+
+void SHA1ManifestWriter::addFile(const std::string& path) {
+	Entry *entry;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.push_back(Entry());
+		entry = &entries.back();
+		entry->path = path;
+		entry->size = 0;
+		entry->status = shaSuccess;
+		pending++;
+	}
+	pool.post([this, entry]() {
+		int err;
+
+		err = SHA1Manifest::hashFile(entry->path.c_str(), &entry->digest, &entry->size);
+		std::lock_guard<std::mutex> lock(mutex);
+		entry->status = err;
+		if (err && !firstError) {
+			firstError = err;
+		}
+		if (--pending == 0) {
+			idle.notify_all();
+		}
+	});
+}
+
+void SHA1ManifestWriter::addEntry(const std::string& path, const SHA1Digest& digest, uint64_t size) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	entries.push_back(Entry());
+	entries.back().path = path;
+	entries.back().size = size;
+	entries.back().digest = digest;
+	entries.back().status = shaSuccess;
+}
+
+int SHA1ManifestWriter::finish(const char *manifestPath) {
+	std::vector<const Entry *> sorted;
+	std::vector<uint64_t> pathOffsets;
+	std::vector<uint64_t> sizes;
+	std::vector<SHA1Digest> digests;
+	SHA1ManifestHeader header;
+	FILE *fp;
+	bool ok;
+
+	if (!manifestPath) {
+		return shaNull;
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return pending == 0; });
+	}
+
+	sorted.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].status == shaSuccess) {
+			sorted.push_back(&entries[i]);
+		}
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Entry *a, const Entry *b) {
+		return a->path < b->path;
+	});
+	sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const Entry *a, const Entry *b) {
+		return a->path == b->path;
+	}), sorted.end());
+
+	pathOffsets.reserve(sorted.size() + 1);
+	sizes.reserve(sorted.size());
+	digests.reserve(sorted.size());
+	pathOffsets.push_back(0);
+	for (size_t i = 0; i < sorted.size(); i++) {
+		pathOffsets.push_back(pathOffsets.back() + sorted[i]->path.size());
+		sizes.push_back(sorted[i]->size);
+		digests.push_back(sorted[i]->digest);
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = 1;
+	header.endian = 0x01020304;
+	header.count = sorted.size();
+	header.pathOffsetsOffset = sizeof(header);
+	header.sizesOffset = header.pathOffsetsOffset + pathOffsets.size() * sizeof(uint64_t);
+	header.digestsOffset = header.sizesOffset + sizes.size() * sizeof(uint64_t);
+	header.pathsOffset = header.digestsOffset + digests.size() * sizeof(SHA1Digest);
+	header.pathsSize = pathOffsets.back();
+
+	fp = fopen(manifestPath, "wb");
+	if (!fp) {
+		return shaFileError;
+	}
+	ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fwrite(pathOffsets.data(), sizeof(uint64_t), pathOffsets.size(), fp) == pathOffsets.size();
+	ok = ok && fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), fp) == sizes.size();
+	ok = ok && fwrite(digests.data(), sizeof(SHA1Digest), digests.size(), fp) == digests.size();
+	for (size_t i = 0; ok && i < sorted.size(); i++) {
+		ok = fwrite(sorted[i]->path.data(), 1, sorted[i]->path.size(), fp) == sorted[i]->path.size();
+	}
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok) {
+		return shaFileError;
+	}
+	return firstError;
+}
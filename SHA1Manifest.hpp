@@ -0,0 +1,209 @@
+/**
+* @file SHA1Manifest.hpp
+* @brief 二进制 SHA1 摘要清单(manifest) C++ 语言头文件
+*
+* @details
+* 与 sha1sum 的文本格式相比, 二进制清单不需要逐行解析十六进制字符串, 文件体积也更小:
+* - 文件按路径字节序排序, 各列分别紧凑存放: 路径偏移表、文件长度数组、20 字节摘要数组、路径字符串区;
+* - SHA1Manifest 以只读方式 mmap 打开清单, 按路径二分查找为 O(log n), 无需加载或解析;
+* - SHA1ManifestWriter 把待计算的文件交给工作线程并行计算摘要, 结束时排序并写出清单;
+* - SHA1Manifest::verify() 直接对映射的记录并行重新计算文件摘要并比较;
+* - 支持与 sha1sum 文本格式("<40 位十六进制摘要>  <路径>")互相转换.
+*
+* 文件格式(整数字段为本机字节序, 通过文件头的 endian 字段识别):
+* @code
+* SHA1ManifestHeader
+* uint64_t   pathOffsets[count + 1]   // 第 i 个路径为 paths[pathOffsets[i] .. pathOffsets[i+1])
+* uint64_t   sizes[count]             // 文件长度, SHA1ManifestUnknownSize 表示未知
+* SHA1Digest digests[count]
+* char       paths[]                  // 不含 '\0' 结尾
+* @endcode
+*
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+* @example example_manifest.cpp 是一个生成、校验和转换清单的 C++ 示例程序
+*/
+
+#ifndef _SHA1_MANIFEST_HPP_
+#define _SHA1_MANIFEST_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include "SHA1Digest.hpp"
+#include "SHA1ThreadPool.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/** 文件长度未知(例如由 sha1sum 文本清单转换而来且文件不存在) */
+static const uint64_t SHA1ManifestUnknownSize = ~(uint64_t) 0;
+
+/** 校验结果 */
+enum SHA1ManifestStatus {
+	SHA1ManifestOK = 0, ///< 摘要相同
+	SHA1ManifestMissing, ///< 文件无法打开或读取
+	SHA1ManifestSizeMismatch, ///< 文件长度不同(无需计算摘要即可判定)
+	SHA1ManifestDigestMismatch, ///< 摘要不同
+};
+
+/**
+ * @class SHA1Manifest
+ * @brief 只读映射的二进制清单
+ */
+class SHA1Manifest {
+public:
+	/** 校验回调: 参数为记录序号和校验结果, 可能在任意工作线程中被调用 */
+	typedef std::function<void(size_t, SHA1ManifestStatus)> VerifyCallback;
+
+private:
+	const uint8_t *base;
+	size_t mappingSize;
+	uint64_t count;
+	const uint64_t *pathOffsets;
+	const uint64_t *sizes;
+	const SHA1Digest *digests;
+	const char *paths;
+	uint64_t pathsSize;
+
+	bool pathAt(uint64_t index, const char **path, size_t *length) const;
+
+public:
+	/** 构造一个空清单 */
+	SHA1Manifest();
+
+	/** 析构函数 */
+	~SHA1Manifest();
+
+	SHA1Manifest(const SHA1Manifest&) = delete;
+	SHA1Manifest& operator=(const SHA1Manifest&) = delete;
+
+	/**
+	 * 以只读方式映射清单文件
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 */
+	int open(const char *path ///< 清单文件名
+			);
+
+	/** 解除映射 */
+	void close();
+
+	/** 查询记录条数 */
+	size_t size() const;
+
+	/**
+	 * 第 index 条记录的路径
+	 *
+	 * @return 路径; 清单损坏(路径偏移越界或逆序)时返回空字符串
+	 */
+	std::string path(size_t index) const;
+
+	/** 第 index 条记录的文件长度 */
+	uint64_t fileSize(size_t index) const;
+
+	/** 第 index 条记录的摘要 */
+	const SHA1Digest& digest(size_t index) const;
+
+	/**
+	 * 按路径二分查找
+	 *
+	 * @details 只检查二分查找途经记录的路径偏移, 打开清单时不扫描整个偏移表
+	 * @return true 表示找到, 序号写入 *index; 途经的记录已损坏时返回 false
+	 */
+	bool find(const std::string& path, ///< 路径(与写入清单时的字符串逐字节相同)
+			size_t *index ///< 输出记录序号
+			) const;
+
+	/**
+	 * 重新计算清单中每个文件的摘要并与记录比较
+	 *
+	 * @return 校验不通过的记录条数
+	 */
+	size_t verify(unsigned int threads, ///< 工作线程数, 0 表示按 SHA1ThreadPool::defaultThreads()
+			VerifyCallback callback = VerifyCallback() ///< 可选: 每条记录校验完成后回调一次
+			) const;
+
+	/**
+	 * 导出为 sha1sum 文本格式
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError(写文件失败或清单损坏)
+	 */
+	int toSha1sum(const char *textPath ///< 输出文本文件名
+			) const;
+
+	/**
+	 * 由 sha1sum 文本格式生成二进制清单
+	 *
+	 * @details 文本格式不含文件长度, 此处对能访问到的文件读取其长度, 否则记为 SHA1ManifestUnknownSize
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaBadParam(文本格式错误) / shaFileError
+	 */
+	static int fromSha1sum(const char *textPath, ///< 输入文本文件名
+			const char *manifestPath ///< 输出清单文件名
+			);
+
+	/**
+	 * 计算一个文件的 SHA1 摘要
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError
+	 */
+	static int hashFile(const char *path, ///< 文件名
+			SHA1Digest *digest, ///< 输出摘要
+			uint64_t *size ///< 可选输出: 文件长度
+			);
+};
+
+/**
+ * @class SHA1ManifestWriter
+ * @brief 并行计算文件摘要并写出二进制清单
+ */
+class SHA1ManifestWriter {
+private:
+	struct Entry {
+		std::string path;
+		uint64_t size;
+		SHA1Digest digest;
+		int status;
+	};
+
+	std::deque<Entry> entries; ///< deque 在尾部追加时不会使已有元素的引用失效, 工作线程可直接写入各自的元素
+	std::mutex mutex;
+	std::condition_variable idle;
+	size_t pending;
+	int firstError;
+	SHA1ThreadPool pool;
+
+public:
+	/** 构造函数 */
+	explicit SHA1ManifestWriter(unsigned int threads = 0 ///< 工作线程数, 0 表示按 SHA1ThreadPool::defaultThreads()
+			);
+
+	/** 析构函数: 等待已提交的文件计算完成 */
+	~SHA1ManifestWriter();
+
+	/** 提交一个文件, 由工作线程计算其摘要和长度 */
+	void addFile(const std::string& path ///< 文件名, 原样记入清单
+			);
+
+	/** 添加一条已知摘要的记录 */
+	void addEntry(const std::string& path, ///< 路径
+			const SHA1Digest& digest, ///< 摘要
+			uint64_t size ///< 文件长度, 未知时为 SHA1ManifestUnknownSize
+			);
+
+	/**
+	 * 等待全部文件计算完成, 按路径排序(路径重复时保留最先添加的一条)后写出清单
+	 *
+	 * @return shaSuccess=0 表示成功, 其他非 0 值表示错误: shaNull / shaFileError(写文件失败或有文件无法读取)
+	 * @note 无法读取的文件不会写入清单
+	 */
+	int finish(const char *manifestPath ///< 输出清单文件名
+			);
+};
+
+#endif//_SHA1_MANIFEST_HPP_
@@ -0,0 +1,60 @@
+#include "SHA1ThreadPool.hpp"
+
+#include <utility>
+
+SHA1ThreadPool::SHA1ThreadPool(unsigned int threads) :
+		stopping(false) {
+	if (threads == 0) {
+		threads = defaultThreads();
+	}
+	workers.reserve(threads);
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&SHA1ThreadPool::workerLoop, this);
+	}
+}
+
+SHA1ThreadPool::~SHA1ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void SHA1ThreadPool::post(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wakeup.notify_one();
+}
+
+unsigned int SHA1ThreadPool::size() const {
+	return (unsigned int) workers.size();
+}
+
+unsigned int SHA1ThreadPool::defaultThreads() {
+	unsigned int n;
+
+	n = std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+void SHA1ThreadPool::workerLoop() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty()) {
+				return; // stopping 且队列已清空
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
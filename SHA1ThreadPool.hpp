@@ -0,0 +1,70 @@
+/**
+* @file SHA1ThreadPool.hpp
+* @brief SHA1 并行哈希工作线程池 C++ 语言头文件
+*
+* @details
+* 一个简单的固定大小线程池, 供分块去重、清单生成等需要并行计算 SHA1 摘要的模块共用.
+* 任务按提交顺序(FIFO)执行; 调用者如需等待结果请自行使用 std::packaged_task / std::future.
+*
+* @note 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+*/
+
+#ifndef _SHA1_THREAD_POOL_HPP_
+#define _SHA1_THREAD_POOL_HPP_
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "This header requires C++11 or later"
+#endif
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class SHA1ThreadPool
+ * @brief 固定数量工作线程的任务队列
+ */
+class SHA1ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping;
+
+	void workerLoop();
+
+public:
+	/**
+	 * 构造函数
+	 *
+	 * @note threads 为 0 时按 defaultThreads() 创建工作线程
+	 */
+	explicit SHA1ThreadPool(unsigned int threads ///< 工作线程数
+			);
+
+	/** 析构函数: 执行完队列中剩余的任务后回收所有工作线程 */
+	~SHA1ThreadPool();
+
+	SHA1ThreadPool(const SHA1ThreadPool&) = delete;
+	SHA1ThreadPool& operator=(const SHA1ThreadPool&) = delete;
+
+	/** 提交一个任务, 由任意空闲工作线程执行 */
+	void post(std::function<void()> task ///< 任务
+			);
+
+	/** 查询工作线程数 */
+	unsigned int size() const;
+
+	/**
+	 * 默认工作线程数
+	 *
+	 * @return std::thread::hardware_concurrency(), 无法探测时返回 1
+	 */
+	static unsigned int defaultThreads();
+};
+
+#endif//_SHA1_THREAD_POOL_HPP_
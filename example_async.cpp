@@ -0,0 +1,124 @@
+/*
+ * example_async.cpp
+ *
+ * Description:
+ * 使用 C++20 协程异步计算 SHA1 的示例程序.
+ * 一个简单的单线程事件循环同时运行一个大文件哈希和若干小请求,
+ * 所有协程都在事件循环线程上恢复. 用法: example_async [大文件]
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++20 选项并且 __cplusplus >= 202002L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+#include "SHA1Async.hpp"
+
+/*
+ * 最简单的事件循环: 其他线程通过 post() 投递协程句柄, run() 在本线程依次恢复
+ */
+class EventLoop
+{
+	std::deque<std::coroutine_handle<> > ready;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	int running = 0;
+
+public:
+	void post(std::coroutine_handle<> handle)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.push_back(handle);
+		wakeup.notify_one();
+	}
+
+	void started() { running++; }
+	void finished() { running--; }
+
+	void run()
+	{
+		while (running > 0)
+		{
+			std::coroutine_handle<> handle;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeup.wait(lock, [this] { return !ready.empty(); });
+				handle = ready.front();
+				ready.pop_front();
+			}
+			handle.resume();
+		}
+	}
+
+	SHA1HashAwaitable::Resumer resumer()
+	{
+		return [this](std::coroutine_handle<> handle) { post(handle); };
+	}
+};
+
+/* 立即开始执行、结束后自动销毁的协程类型 */
+struct Detached
+{
+	struct promise_type
+	{
+		Detached get_return_object() { return Detached(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+static Detached hashString(SHA1HashExecutor& executor, EventLoop& loop, const char *text)
+{
+	loop.started();
+	SHA1AsyncResult r = co_await executor.hash((const uint8_t *) text, strlen(text), loop.resumer());
+	printf("\"%s\": %s\n", text, r.digest.toHex().c_str());
+	loop.finished();
+}
+
+static Detached hashPath(SHA1HashExecutor& executor, EventLoop& loop, const char *path)
+{
+	loop.started();
+	int fd = open(path, O_RDONLY);
+	SHA1AsyncResult r = co_await executor.hashFile(fd, 0, ~(uint64_t) 0, loop.resumer());
+	if (r.status == shaSuccess)
+	{
+		printf("%s: %s (%llu bytes)\n", path, r.digest.toHex().c_str(), (unsigned long long) r.length);
+	}
+	else
+	{
+		printf("%s: error %d\n", path, r.status);
+	}
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	loop.finished();
+}
+
+int main(int argc, char *argv[])
+{
+	SHA1HashExecutor executor(1);
+	EventLoop loop;
+
+	if (argc > 1)
+	{
+		hashPath(executor, loop, argv[1]); // 大文件按时间片计算, 不会阻塞下面的小请求
+	}
+	hashString(executor, loop, "abc");
+	hashString(executor, loop, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+	loop.run();
+	return 0;
+}
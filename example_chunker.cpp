@@ -0,0 +1,77 @@
+/*
+ * example_chunker.cpp
+ *
+ * Description:
+ * 对一个文件(或标准输入)进行内容定义分块, 输出每个分块的偏移、长度和 SHA1 摘要,
+ * 并统计重复分块. 用法: example_chunker [文件名] [工作线程数]
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <set>
+#include <string>
+
+#include "SHA1Chunker.hpp"
+
+int main(int argc, char *argv[])
+{
+	FILE *fp = stdin;
+	unsigned int workers = 0;
+	std::set<std::string> seen;
+	uint64_t duplicateBytes = 0;
+	uint64_t totalBytes = 0;
+
+	if (argc > 1 && strcmp(argv[1], "-") != 0)
+	{
+		fp = fopen(argv[1], "rb");
+		if (!fp)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+	}
+	if (argc > 2)
+	{
+		workers = (unsigned int) atoi(argv[2]);
+	}
+
+	SHA1Chunker chunker(SHA1ChunkerParameters(2048, 8192, 65536),
+			[&](const SHA1ChunkRecord& record)
+			{
+				printf("%012llu %6u ", (unsigned long long) record.offset, record.length);
+				for (int i = 0; i < SHA1HashSize; ++i)
+				{
+					printf("%02x", record.digest[i]);
+				}
+				printf("\n");
+
+				totalBytes += record.length;
+				if (!seen.insert(std::string((const char *) record.digest, SHA1HashSize)).second)
+				{
+					duplicateBytes += record.length;
+				}
+			},
+			workers);
+
+	static uint8_t buffer[1 << 20];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		chunker.inputData(buffer, n);
+	}
+	chunker.inputEnd();
+
+	printf("Total %llu bytes, %llu bytes in duplicate chunks\n",
+			(unsigned long long) totalBytes, (unsigned long long) duplicateBytes);
+	if (fp != stdin)
+	{
+		fclose(fp);
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * example_client.cpp
+ *
+ * Description:
+ * 通过本机 SHA1 守护进程(sha1d)计算摘要的示例程序:
+ * 先用与 SHA1 类相同风格的 SHA1Remote 计算三个标准测试向量(第 3 个向量再用零复制的
+ * inputBuffer() 计算一次), 再批量计算命令行给出的文件.
+ * 用法: example_client [文件]...
+ *
+ * Portability Issues:
+ * 仅支持 Linux; 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "SHA1Client.hpp"
+
+const char *testarray[3] = {
+	"abc",
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	"01234567012345670123456701234567",
+};
+
+int main(int argc, char *argv[])
+{
+	SHA1Client client;
+
+	if (client.connect() != shaSuccess)
+	{
+		fprintf(stderr, "cannot connect to sha1d\n");
+		return 1;
+	}
+
+	SHA1Remote calc(client);
+	for (int j = 0; j < 3; j++)
+	{
+		SHA1Digest digest;
+
+		calc.reset();
+		calc.inputData((const uint8_t *) testarray[j], strlen(testarray[j]));
+		if (j == 2)
+		{
+			for (int k = 1; k < 20; k++) // 第 3 个测试向量为 640 字节
+			{
+				calc.inputData((const uint8_t *) testarray[j], strlen(testarray[j]));
+			}
+		}
+		calc.inputEnd();
+		if (calc.getHashResult(digest) != shaSuccess)
+		{
+			fprintf(stderr, "[Test-%d] failed\n", j + 1);
+			return 1;
+		}
+		printf("[Test-%d] %s\n", j + 1, digest.toHex().c_str());
+	}
+
+	/* 零复制: 第 3 个测试向量直接生成在 memfd 的映射中, 前 8 字节仍用 inputData() 输入 */
+	{
+		SHA1Digest digest;
+		uint8_t *buffer;
+
+		calc.reset();
+		calc.inputData((const uint8_t *) testarray[2], 8);
+		buffer = calc.inputBuffer(632);
+		for (int k = 0; buffer && k < 632; k++)
+		{
+			buffer[k] = testarray[2][k % 8];
+		}
+		calc.inputEnd();
+		if (!buffer || calc.getHashResult(digest) != shaSuccess)
+		{
+			fprintf(stderr, "[Test-4] failed\n");
+			return 1;
+		}
+		printf("[Test-4] %s (inputBuffer)\n", digest.toHex().c_str());
+		printf("Should match: dea356a2cddd90c7a7ecedc5ebb563934f460452\n");
+	}
+
+	std::vector<int> fds;
+	for (int i = 1; i < argc; i++)
+	{
+		int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		fds.push_back(fd);
+	}
+	std::vector<SHA1Digest> digests(fds.size());
+	std::vector<int> status(fds.size());
+	if (client.hashBatch(fds.data(), fds.size(), digests.data(), status.data()) != shaSuccess)
+	{
+		fprintf(stderr, "lost connection to sha1d\n");
+		return 1;
+	}
+	for (size_t i = 0; i < fds.size(); i++)
+	{
+		if (status[i] == shaSuccess)
+		{
+			printf("%s  %s\n", digests[i].toHex().c_str(), argv[i + 1]);
+		}
+		else
+		{
+			printf("%s: error %d\n", argv[i + 1], status[i]);
+		}
+		close(fds[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * example_collision.cpp
+ *
+ * Description:
+ * 碰撞检测模式的示例程序: 先在检测模式下计算三个标准测试向量,
+ * 再计算公开的 SHAttered 碰撞 PDF 的前 320 字节(两组碰撞分组都应被检测到),
+ * 最后比较关闭和开启碰撞检测时的计算速度(两种模式每 1 MB 交替运行, 各取最快的一次).
+ * 测试数据一次性整块输入, SHA1Input() 直接按 64 字节分组压缩,
+ * 因此两者之差即为压缩函数中碰撞检测的额外开销.
+ * 用法: example_collision [测试数据 MB 数]
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "SHA1.hpp"
+#include "SHA1Digest.hpp"
+
+const char *testarray[3] = {
+	"abc",
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	"01234567012345670123456701234567",
+};
+
+const char *strCorrectSHA1Result[3] = {
+	"a9993e364706816aba3e25717850c26c9cd0d89d",
+	"84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+	"dea356a2cddd90c7a7ecedc5ebb563934f460452",
+};
+
+/* SHAttered 两个 PDF 文件(shattered-1.pdf / shattered-2.pdf)共同的前 192 字节 */
+static const uint8_t shatteredPrefix[192] = {
+	0x25, 0x50, 0x44, 0x46, 0x2d, 0x31, 0x2e, 0x33, 0x0a, 0x25, 0xe2, 0xe3, 0xcf, 0xd3, 0x0a, 0x0a,
+	0x0a, 0x31, 0x20, 0x30, 0x20, 0x6f, 0x62, 0x6a, 0x0a, 0x3c, 0x3c, 0x2f, 0x57, 0x69, 0x64, 0x74,
+	0x68, 0x20, 0x32, 0x20, 0x30, 0x20, 0x52, 0x2f, 0x48, 0x65, 0x69, 0x67, 0x68, 0x74, 0x20, 0x33,
+	0x20, 0x30, 0x20, 0x52, 0x2f, 0x54, 0x79, 0x70, 0x65, 0x20, 0x34, 0x20, 0x30, 0x20, 0x52, 0x2f,
+	0x53, 0x75, 0x62, 0x74, 0x79, 0x70, 0x65, 0x20, 0x35, 0x20, 0x30, 0x20, 0x52, 0x2f, 0x46, 0x69,
+	0x6c, 0x74, 0x65, 0x72, 0x20, 0x36, 0x20, 0x30, 0x20, 0x52, 0x2f, 0x43, 0x6f, 0x6c, 0x6f, 0x72,
+	0x53, 0x70, 0x61, 0x63, 0x65, 0x20, 0x37, 0x20, 0x30, 0x20, 0x52, 0x2f, 0x4c, 0x65, 0x6e, 0x67,
+	0x74, 0x68, 0x20, 0x38, 0x20, 0x30, 0x20, 0x52, 0x2f, 0x42, 0x69, 0x74, 0x73, 0x50, 0x65, 0x72,
+	0x43, 0x6f, 0x6d, 0x70, 0x6f, 0x6e, 0x65, 0x6e, 0x74, 0x20, 0x38, 0x3e, 0x3e, 0x0a, 0x73, 0x74,
+	0x72, 0x65, 0x61, 0x6d, 0x0a, 0xff, 0xd8, 0xff, 0xfe, 0x00, 0x24, 0x53, 0x48, 0x41, 0x2d, 0x31,
+	0x20, 0x69, 0x73, 0x20, 0x64, 0x65, 0x61, 0x64, 0x21, 0x21, 0x21, 0x21, 0x21, 0x85, 0x2f, 0xec,
+	0x09, 0x23, 0x39, 0x75, 0x9c, 0x39, 0xb1, 0xa1, 0xc6, 0x3c, 0x4c, 0x97, 0xe1, 0xff, 0xfe, 0x01,
+};
+
+/* shattered-1.pdf 的两个近似碰撞分组(第 193..320 字节) */
+static const uint8_t shatteredBlocks1[128] = {
+	0x7f, 0x46, 0xdc, 0x93, 0xa6, 0xb6, 0x7e, 0x01, 0x3b, 0x02, 0x9a, 0xaa, 0x1d, 0xb2, 0x56, 0x0b,
+	0x45, 0xca, 0x67, 0xd6, 0x88, 0xc7, 0xf8, 0x4b, 0x8c, 0x4c, 0x79, 0x1f, 0xe0, 0x2b, 0x3d, 0xf6,
+	0x14, 0xf8, 0x6d, 0xb1, 0x69, 0x09, 0x01, 0xc5, 0x6b, 0x45, 0xc1, 0x53, 0x0a, 0xfe, 0xdf, 0xb7,
+	0x60, 0x38, 0xe9, 0x72, 0x72, 0x2f, 0xe7, 0xad, 0x72, 0x8f, 0x0e, 0x49, 0x04, 0xe0, 0x46, 0xc2,
+	0x30, 0x57, 0x0f, 0xe9, 0xd4, 0x13, 0x98, 0xab, 0xe1, 0x2e, 0xf5, 0xbc, 0x94, 0x2b, 0xe3, 0x35,
+	0x42, 0xa4, 0x80, 0x2d, 0x98, 0xb5, 0xd7, 0x0f, 0x2a, 0x33, 0x2e, 0xc3, 0x7f, 0xac, 0x35, 0x14,
+	0xe7, 0x4d, 0xdc, 0x0f, 0x2c, 0xc1, 0xa8, 0x74, 0xcd, 0x0c, 0x78, 0x30, 0x5a, 0x21, 0x56, 0x64,
+	0x61, 0x30, 0x97, 0x89, 0x60, 0x6b, 0xd0, 0xbf, 0x3f, 0x98, 0xcd, 0xa8, 0x04, 0x46, 0x29, 0xa1,
+};
+
+/* shattered-2.pdf 的两个近似碰撞分组, 与上面的分组产生完全相同的内部状态 */
+static const uint8_t shatteredBlocks2[128] = {
+	0x73, 0x46, 0xdc, 0x91, 0x66, 0xb6, 0x7e, 0x11, 0x8f, 0x02, 0x9a, 0xb6, 0x21, 0xb2, 0x56, 0x0f,
+	0xf9, 0xca, 0x67, 0xcc, 0xa8, 0xc7, 0xf8, 0x5b, 0xa8, 0x4c, 0x79, 0x03, 0x0c, 0x2b, 0x3d, 0xe2,
+	0x18, 0xf8, 0x6d, 0xb3, 0xa9, 0x09, 0x01, 0xd5, 0xdf, 0x45, 0xc1, 0x4f, 0x26, 0xfe, 0xdf, 0xb3,
+	0xdc, 0x38, 0xe9, 0x6a, 0xc2, 0x2f, 0xe7, 0xbd, 0x72, 0x8f, 0x0e, 0x45, 0xbc, 0xe0, 0x46, 0xd2,
+	0x3c, 0x57, 0x0f, 0xeb, 0x14, 0x13, 0x98, 0xbb, 0x55, 0x2e, 0xf5, 0xa0, 0xa8, 0x2b, 0xe3, 0x31,
+	0xfe, 0xa4, 0x80, 0x37, 0xb8, 0xb5, 0xd7, 0x1f, 0x0e, 0x33, 0x2e, 0xdf, 0x93, 0xac, 0x35, 0x00,
+	0xeb, 0x4d, 0xdc, 0x0d, 0xec, 0xc1, 0xa8, 0x64, 0x79, 0x0c, 0x78, 0x2c, 0x76, 0x21, 0x56, 0x60,
+	0xdd, 0x30, 0x97, 0x91, 0xd0, 0x6b, 0xd0, 0xaf, 0x3f, 0x98, 0xcd, 0xa4, 0xbc, 0x46, 0x29, 0xb1,
+};
+
+/* 计算 SHAttered 前缀(公共部分 + 一组碰撞分组)的摘要, 返回是否检测到碰撞 */
+static bool hashShattered(SHA1& calc, const uint8_t blocks[128], SHA1Digest& digest)
+{
+	calc.reset();
+	calc.inputData(shatteredPrefix, sizeof(shatteredPrefix));
+	calc.inputData(blocks, 128);
+	calc.inputEnd();
+	calc.getHashResult(digest);
+	return calc.isCollisionDetected();
+}
+
+/* 计算 data 的摘要, 返回耗时(秒) */
+/* 计算整段数据的摘要, 返回所用时间(秒) */
+static double measure(SHA1& calc, const uint8_t data[], size_t length, SHA1Digest& digest)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	calc.reset();
+	calc.inputData(data, (unsigned int) length);
+	calc.inputEnd();
+	calc.getHashResult(digest);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+	SHA1 calc;
+	int megabytes = (argc > 1) ? atoi(argv[1]) : 256;
+
+	calc.setCollisionDetection(true);
+	for (int j = 0; j < 3; j++)
+	{
+		SHA1Digest digest;
+
+		calc.reset();
+		calc.inputData((const uint8_t *) testarray[j], strlen(testarray[j]));
+		if (j == 2)
+		{
+			for (int k = 1; k < 20; k++) // 第 3 个测试向量为 640 字节
+			{
+				calc.inputData((const uint8_t *) testarray[j], strlen(testarray[j]));
+			}
+		}
+		calc.inputEnd();
+		calc.getHashResult(digest);
+		printf("[Test-%d] %s %s\n", j + 1, digest.toHex().c_str(),
+				calc.isCollisionDetected() ? "COLLISION" : "ok");
+		printf("Should match: %s\n", strCorrectSHA1Result[j]);
+	}
+
+	/* 真实碰撞: 两个前缀的摘要相同, 检测模式下两者都应被标记 */
+	SHA1Digest shattered1, shattered2;
+	bool plainFlagged, detected1, detected2;
+
+	calc.setCollisionDetection(false);
+	plainFlagged = hashShattered(calc, shatteredBlocks1, shattered1);
+	printf("\n[SHAttered] plain:     %s %s\n", shattered1.toHex().c_str(), plainFlagged ? "COLLISION" : "ok");
+	calc.setCollisionDetection(true);
+	detected1 = hashShattered(calc, shatteredBlocks1, shattered1);
+	detected2 = hashShattered(calc, shatteredBlocks2, shattered2);
+	printf("[SHAttered] detection: %s %s\n", shattered1.toHex().c_str(), detected1 ? "COLLISION" : "ok");
+	printf("[SHAttered] detection: %s %s\n", shattered2.toHex().c_str(), detected2 ? "COLLISION" : "ok");
+	printf("Should match: f92d74e3874587aaf443d1db961d4e26dde13e9c COLLISION\n");
+	if (plainFlagged || !detected1 || !detected2 || !(shattered1 == shattered2))
+	{
+		return 1;
+	}
+
+	if (megabytes <= 0)
+	{
+		return 0;
+	}
+	std::vector<uint8_t> data((size_t) megabytes << 20);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		data[i] = (uint8_t) (seed >> 16);
+	}
+
+	SHA1Digest plain, detected;
+	const size_t slice = 1 << 20;
+	double t0 = 0, t1 = 0;
+
+	/* 每 1 MB 交替计时 5 轮, 各取最快的一次再累加, 减少其他进程的干扰 */
+	for (size_t offset = 0; offset < data.size(); offset += slice)
+	{
+		double best0 = 0, best1 = 0;
+
+		for (int round = 0; round < 5; round++)
+		{
+			double t;
+
+			calc.setCollisionDetection(false);
+			t = measure(calc, data.data() + offset, slice, plain);
+			best0 = (round == 0 || t < best0) ? t : best0;
+			calc.setCollisionDetection(true);
+			t = measure(calc, data.data() + offset, slice, detected);
+			best1 = (round == 0 || t < best1) ? t : best1;
+		}
+		t0 += best0;
+		t1 += best1;
+	}
+	calc.setCollisionDetection(false);
+	measure(calc, data.data(), data.size(), plain);
+	calc.setCollisionDetection(true);
+	measure(calc, data.data(), data.size(), detected);
+	printf("\n%d MB random data (%d blocks):\n", megabytes, megabytes << 14);
+	printf("  plain:     %s %8.1f MB/s\n", plain.toHex().c_str(), megabytes / t0);
+	printf("  detection: %s %8.1f MB/s (%+.1f%%)%s\n", detected.toHex().c_str(), megabytes / t1,
+			(t1 / t0 - 1) * 100, calc.isCollisionDetected() ? " COLLISION" : "");
+	return (plain == detected && !calc.isCollisionDetected()) ? 0 : 1;
+}
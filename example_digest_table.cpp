@@ -0,0 +1,196 @@
+/*
+ * example_digest_table.cpp
+ *
+ * Description:
+ * SHA1 摘要集合的示例程序: 插入一批已知摘要, 检查重复插入、单个查询与批量查询,
+ * 再保存为磁盘格式并以只读映射方式打开, 检查映射后的查询结果和插入限制,
+ * 最后检查损坏的表文件(文件头错误、没有空槽位)不会导致越界访问或无限探测.
+ * 用法: example_digest_table [表文件名]
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "SHA1.hpp"
+#include "SHA1DigestTable.hpp"
+
+/* 计算字符串 "<prefix>-<i>" 的摘要 */
+static SHA1Digest digestOf(const char *prefix, int i)
+{
+	char text[64];
+	SHA1 calc;
+	SHA1Digest digest;
+
+	snprintf(text, sizeof(text), "%s-%d", prefix, i);
+	calc.inputData((const uint8_t *) text, strlen(text));
+	calc.inputEnd();
+	calc.getHashResult(digest);
+	return digest;
+}
+
+/* 对 hits 个已插入和 misses 个未插入的摘要比较 containsBatch() 与 contains(), 返回命中个数(不一致时返回 -1) */
+static int checkQueries(const SHA1DigestTable& table, int hits, int misses)
+{
+	std::vector<SHA1Digest> queries;
+	int found = 0;
+
+	for (int i = 0; i < hits || i < misses; i++)
+	{
+		if (i < hits)
+		{
+			queries.push_back(digestOf("item", i));
+		}
+		if (i < misses)
+		{
+			queries.push_back(digestOf("missing", i));
+		}
+	}
+	std::unique_ptr<bool[]> result(new bool[queries.size()]);
+	table.containsBatch(queries.data(), queries.size(), result.get());
+	for (size_t i = 0; i < queries.size(); i++)
+	{
+		if (result[i] != table.contains(queries[i]))
+		{
+			return -1;
+		}
+		found += result[i] ? 1 : 0;
+	}
+	return found;
+}
+
+/* 读出整个文件, 由 patch 修改后写回, 用于构造损坏的表文件 */
+template<typename Patch>
+static bool patchFile(const char *path, Patch patch)
+{
+	std::vector<uint8_t> data;
+	FILE *fp;
+	int c;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	while ((c = fgetc(fp)) != EOF)
+	{
+		data.push_back((uint8_t) c);
+	}
+	fclose(fp);
+	patch(data);
+	fp = fopen(path, "wb");
+	if (!fp)
+	{
+		return false;
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	return (fclose(fp) == 0) && ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = (argc > 1) ? argv[1] : "example_digest_table.bin";
+	const int count = 1000;
+	SHA1DigestTable table(16); // 预留很小的空间, 插入过程中会多次扩容
+	SHA1Digest abc;
+	bool inserted;
+	int failures = 0;
+
+	/* 插入已知摘要: 第 1 个测试向量 "abc" */
+	SHA1Digest::fromHex("a9993e364706816aba3e25717850c26c9cd0d89d", &abc);
+	table.insert(abc, &inserted);
+	printf("[Insert] abc: %s, contains: %s\n", inserted ? "true" : "false", table.contains(abc) ? "true" : "false");
+	printf("Should match: true, contains: true\n");
+	failures += !inserted || !table.contains(abc);
+
+	table.insert(abc, &inserted);
+	printf("[Re-insert] abc: %s, size: %llu\n", inserted ? "true" : "false", (unsigned long long) table.size());
+	printf("Should match: false, size: 1\n");
+	failures += inserted || table.size() != 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		table.insert(digestOf("item", i), &inserted);
+		failures += !inserted;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		table.insert(digestOf("item", i), &inserted);
+		failures += inserted;
+	}
+	printf("[Insert] %d digests twice: size %llu, capacity %llu\n", count, (unsigned long long) table.size(),
+			(unsigned long long) table.capacity());
+	printf("Should match: size %d\n", count + 1);
+	failures += table.size() != (uint64_t) count + 1;
+
+	/* 批量查询: 命中和未命中交替排列, 结果必须与逐个查询相同 */
+	int found = checkQueries(table, count, count);
+	printf("[Batch] %d hits + %d misses: found %d\n", count, count, found);
+	printf("Should match: found %d\n", count);
+	failures += found != count;
+
+	/* 保存并映射 */
+	if (table.save(path) != shaSuccess)
+	{
+		perror(path);
+		return 1;
+	}
+	SHA1DigestTable mapped;
+	if (mapped.openMapped(path) != shaSuccess)
+	{
+		perror(path);
+		remove(path);
+		return 1;
+	}
+	found = checkQueries(mapped, count, count);
+	printf("[Mapped] size %llu, mapped: %s, contains abc: %s, found %d\n", (unsigned long long) mapped.size(),
+			mapped.isMapped() ? "true" : "false", mapped.contains(abc) ? "true" : "false", found);
+	printf("Should match: size %d, mapped: true, contains abc: true, found %d\n", count + 1, count);
+	failures += mapped.size() != table.size() || !mapped.isMapped() || !mapped.contains(abc) || found != count;
+
+	int err = mapped.insert(digestOf("missing", 0));
+	printf("[Mapped] insert: %d, size %llu\n", err, (unsigned long long) mapped.size());
+	printf("Should match: %d (shaStateError), size %d\n", shaStateError, count + 1);
+	failures += err != shaStateError || mapped.size() != (uint64_t) count + 1;
+
+	mapped.clear();
+
+	/* 损坏的文件: 元素个数超过装载上限 7/8 的文件头必须被拒绝 */
+	uint64_t groups = table.capacity() / SHA1DigestTable::GroupSize;
+	patchFile(path, [&](std::vector<uint8_t>& data)
+	{
+		uint64_t tooMany = groups * SHA1DigestTable::GroupSize;
+
+		memcpy(&data[24], &tooMany, sizeof(tooMany)); // 文件头的 count 字段
+	});
+	err = mapped.openMapped(path);
+	printf("[Corrupt] count over load limit: openMapped %d\n", err);
+	printf("Should match: %d (shaFileError)\n", shaFileError);
+	failures += err != shaFileError;
+
+	/* 损坏的文件: 所有控制字节都标记为已占用, 查询不存在的摘要也必须在有限步内结束 */
+	table.save(path);
+	patchFile(path, [&](std::vector<uint8_t>& data)
+	{
+		uint64_t controlOffset;
+
+		memcpy(&controlOffset, &data[32], sizeof(controlOffset)); // 文件头的 controlOffset 字段
+		memset(&data[controlOffset], 0x00, groups * SHA1DigestTable::GroupSize);
+	});
+	err = mapped.openMapped(path);
+	found = (err == shaSuccess) ? checkQueries(mapped, 0, count) : -1;
+	printf("[Corrupt] no empty slot: openMapped %d, found %d of %d missing\n", err, found, count);
+	printf("Should match: openMapped 0, found 0 of %d missing\n", count);
+	failures += err != shaSuccess || found != 0;
+
+	mapped.clear();
+	remove(path);
+	printf("\n%s\n", failures ? "FAILED" : "All tests passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * example_git.cpp
+ *
+ * Description:
+ * 在 git 之外计算 git 对象 ID 的示例程序. 用法:
+ *   example_git <文件>...     输出各文件的 blob ID, 与 git hash-object 相同
+ *   example_git -t <目录>     输出目录的 tree ID, 与 git add -A --force && git write-tree 相同
+ *                             (不读取 .gitignore, 被忽略的文件也计入; 不支持子模块)
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SHA1GitObject.hpp"
+
+int main(int argc, char *argv[])
+{
+	SHA1Digest id;
+
+	if (argc == 3 && strcmp(argv[1], "-t") == 0)
+	{
+		if (SHA1GitObject::treeIdForDirectory(argv[2], &id) != shaSuccess)
+		{
+			fprintf(stderr, "%s: failed to hash directory\n", argv[2]);
+			return 1;
+		}
+		printf("%s\n", id.toHex().c_str());
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (SHA1GitObject::blobIdForFile(argv[i], &id) != shaSuccess)
+		{
+			fprintf(stderr, "%s: failed to hash file\n", argv[i]);
+			return 1;
+		}
+		printf("%s\n", id.toHex().c_str());
+	}
+	return 0;
+}
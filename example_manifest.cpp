@@ -0,0 +1,86 @@
+/*
+ * example_manifest.cpp
+ *
+ * Description:
+ * 二进制 SHA1 清单的生成、查询、校验和格式转换示例程序. 用法:
+ *   example_manifest create <清单> <文件>...     并行计算文件摘要并写出清单
+ *   example_manifest lookup <清单> <路径>        查询一条记录
+ *   example_manifest verify <清单>               重新计算并校验清单中的全部文件
+ *   example_manifest export <清单> <文本>        转换为 sha1sum 文本格式
+ *   example_manifest import <文本> <清单>        由 sha1sum 文本格式生成清单
+ *
+ * Portability Issues:
+ * 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SHA1Manifest.hpp"
+
+static const char *statusText[] = {
+	"OK",
+	"MISSING",
+	"SIZE MISMATCH",
+	"DIGEST MISMATCH",
+};
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 3 && strcmp(argv[1], "create") == 0)
+	{
+		SHA1ManifestWriter writer;
+
+		for (int i = 3; i < argc; i++)
+		{
+			writer.addFile(argv[i]);
+		}
+		return writer.finish(argv[2]);
+	}
+	if (argc == 4 && strcmp(argv[1], "import") == 0)
+	{
+		return SHA1Manifest::fromSha1sum(argv[2], argv[3]);
+	}
+
+	SHA1Manifest manifest;
+	if (argc < 3 || manifest.open(argv[2]) != shaSuccess)
+	{
+		fprintf(stderr, "usage: %s create|lookup|verify|export|import ...\n", argv[0]);
+		return 1;
+	}
+
+	if (argc == 4 && strcmp(argv[1], "lookup") == 0)
+	{
+		size_t i;
+
+		if (!manifest.find(argv[3], &i))
+		{
+			printf("%s: not found\n", argv[3]);
+			return 1;
+		}
+		printf("%s  %s  %llu bytes\n", manifest.digest(i).toHex().c_str(), argv[3],
+				(unsigned long long) manifest.fileSize(i));
+		return 0;
+	}
+	if (argc == 3 && strcmp(argv[1], "verify") == 0)
+	{
+		size_t failures;
+
+		failures = manifest.verify(0, [&](size_t i, SHA1ManifestStatus status)
+		{
+			if (status != SHA1ManifestOK)
+			{
+				fprintf(stderr, "%s: %s\n", manifest.path(i).c_str(), statusText[status]);
+			}
+		});
+		printf("%llu of %llu files failed\n", (unsigned long long) failures, (unsigned long long) manifest.size());
+		return failures ? 1 : 0;
+	}
+	if (argc == 4 && strcmp(argv[1], "export") == 0)
+	{
+		return manifest.toSha1sum(argv[3]);
+	}
+	fprintf(stderr, "usage: %s create|lookup|verify|export|import ...\n", argv[0]);
+	return 1;
+}
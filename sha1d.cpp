@@ -0,0 +1,73 @@
+/*
+ * sha1d.cpp
+ *
+ * Description:
+ * 本机 SHA1 哈希守护进程. 用法:
+ *   sha1d [-s 套接字路径] [-t 工作线程数]
+ * 套接字路径默认按 SHA1DaemonDefaultSocket(): 环境变量 SHA1D_SOCKET, $XDG_RUNTIME_DIR/sha1d.sock
+ * 或 /tmp/sha1d-<uid>/sha1d.sock.
+ * 收到 SIGINT / SIGTERM 后退出并删除套接字文件.
+ *
+ * Portability Issues:
+ * 仅支持 Linux; 需要 C++ 编译器支持 -std=c++11 选项并且 __cplusplus >= 201103L
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SHA1Daemon.hpp"
+
+static SHA1Daemon *daemonInstance = NULL;
+
+static void onSignal(int)
+{
+	if (daemonInstance)
+	{
+		daemonInstance->stop();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::string socketPath = SHA1DaemonDefaultSocket();
+	unsigned int threads = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			socketPath = optarg;
+			break;
+		case 't':
+			threads = (unsigned int) atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-s socket] [-t threads]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	SHA1Daemon daemon(threads);
+	if (daemon.listen(socketPath.c_str()) != shaSuccess)
+	{
+		perror(socketPath.c_str());
+		return 1;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	daemonInstance = &daemon;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	int err = daemon.run();
+	daemonInstance = NULL;
+	return err;
+}